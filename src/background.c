@@ -18,6 +18,13 @@
 #include "image.h"
 #include "gradient.h"
 #include "hint.h"
+#include "event.h"
+#include "screen.h"
+#include "imagecache.h"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
 
 /** Enumeration of background types. */
 typedef unsigned char BackgroundType;
@@ -27,6 +34,22 @@ typedef unsigned char BackgroundType;
 #define BACKGROUND_STRETCH    3  /**< Stretched image. */
 #define BACKGROUND_TILE       4  /**< Tiled image. */
 #define BACKGROUND_SCALE      5  /**< Scaled image. */
+#define BACKGROUND_FILL       6  /**< Image scaled to fill each screen. */
+
+/** Preparation state of a background. */
+typedef unsigned char BackgroundStateType;
+#define BACKGROUND_READY      0  /**< The pixmap (if any) is ready. */
+#define BACKGROUND_QUEUED     1  /**< Waiting for a worker. */
+#define BACKGROUND_LOADING    2  /**< Being prepared by a worker. */
+
+/** Maximum number of image backgrounds prepared at the same time. */
+#define MAX_BACKGROUND_WORKERS 2
+
+/** Header sent by a worker before the image data. */
+typedef struct BackgroundHeader {
+   int width;
+   int height;
+} BackgroundHeader;
 
 /** Structure to represent a background for one or more desktops. */
 typedef struct BackgroundNode {
@@ -34,9 +57,30 @@ typedef struct BackgroundNode {
    BackgroundType type;          /**< The type of background. */
    char *value;
    Pixmap pixmap;
+
+   BackgroundStateType state;    /**< Preparation state. */
+   IconNode *icon;               /**< Icon while being prepared. */
+   ImageNode *image;             /**< Image received from the worker. */
+   BackgroundHeader header;      /**< Header received from the worker. */
+   unsigned received;            /**< Bytes received for this image. */
+   int record;                   /**< Index of the image being received. */
+   int fd;                       /**< Pipe from the worker (-1 if none). */
+
    struct BackgroundNode *next;  /**< Next background in the list. */
 } BackgroundNode;
 
+/** Image scaled to the size of a screen.
+ * Tiles are only kept until the background pixmap is composed; after
+ * that the rendered pixmap is found in the image cache.
+ */
+typedef struct BackgroundTile {
+   char *name;                   /**< File name of the image. */
+   long mtime;                   /**< Modification time of the file. */
+   BackgroundType type;          /**< The type of background. */
+   ImageNode *image;             /**< The scaled image. */
+   struct BackgroundTile *next;  /**< Next tile in the list. */
+} BackgroundTile;
+
 /** Linked list of backgrounds. */
 static BackgroundNode *backgrounds;
 
@@ -46,8 +90,40 @@ static BackgroundNode *defaultBackground;
 /** The last background loaded. */
 static BackgroundNode *lastBackground;
 
+/** Number of running workers. */
+static unsigned workerCount;
+
+/** Cached screen tiles. */
+static BackgroundTile *tiles = NULL;
+
+static BackgroundNode *GetDesktopBackground(int desktop);
 static void LoadGradientBackground(BackgroundNode *bp);
 static void LoadImageBackground(BackgroundNode *bp);
+static void BuildImageBackground(BackgroundNode *bp);
+static void GetBackgroundPixmapSize(const BackgroundNode *bp,
+                                    int *width, int *height);
+static unsigned long GetBackgroundKey(const BackgroundNode *bp);
+static void GetImageBackgroundSize(const BackgroundNode *bp,
+                                   int *width, int *height);
+static void StartBackgroundWorkers(void);
+static void StartBackgroundWorker(BackgroundNode *bp);
+static void RunBackgroundWorker(const BackgroundNode *bp, int fd);
+static void RunFillWorker(const BackgroundNode *bp, int fd);
+static char SendBackgroundImage(int fd, const ImageNode *image);
+static char WriteAll(int fd, const void *buffer, size_t length);
+static void HandleBackgroundData(int fd, void *data);
+static char StoreBackgroundImage(BackgroundNode *bp);
+static void FinishImageBackground(BackgroundNode *bp);
+static void BuildFillBackground(BackgroundNode *bp);
+static ImageNode *LoadFillSource(const BackgroundNode *bp);
+static BackgroundTile *FindTile(const char *name, BackgroundType type,
+                                int width, int height);
+static BackgroundTile *CreateTile(const char *name, BackgroundType type,
+                                  const ImageNode *source,
+                                  int width, int height);
+static BackgroundTile *InsertTile(const char *name, BackgroundType type,
+                                  ImageNode *image);
+static void ReleaseTiles(const char *name, BackgroundType type);
 
 /** Initialize any data needed for background support. */
 void InitializeBackgrounds(void)
@@ -55,6 +131,7 @@ void InitializeBackgrounds(void)
    backgrounds = NULL;
    defaultBackground = NULL;
    lastBackground = NULL;
+   workerCount = 0;
 }
 
 /** Startup background support. */
@@ -77,6 +154,7 @@ void StartupBackgrounds(void)
       case BACKGROUND_STRETCH:
       case BACKGROUND_TILE:
       case BACKGROUND_SCALE:
+      case BACKGROUND_FILL:
          LoadImageBackground(bp);
          break;
       default:
@@ -90,6 +168,8 @@ void StartupBackgrounds(void)
 
    }
 
+   StartBackgroundWorkers();
+
 }
 
 /** Shutdown background support. */
@@ -97,11 +177,27 @@ void ShutdownBackgrounds(void)
 {
    BackgroundNode *bp;
    for(bp = backgrounds; bp; bp = bp->next) {
+      if(bp->fd >= 0) {
+         UnregisterDescriptor(bp->fd);
+         close(bp->fd);
+         bp->fd = -1;
+      }
+      if(bp->image) {
+         DestroyImage(bp->image);
+         bp->image = NULL;
+      }
+      if(bp->icon) {
+         DestroyIcon(bp->icon);
+         bp->icon = NULL;
+      }
+      bp->state = BACKGROUND_READY;
       if(bp->pixmap != None) {
          JXFreePixmap(display, bp->pixmap);
          bp->pixmap = None;
       }
    }
+   workerCount = 0;
+   ReleaseTiles(NULL, 0);
 }
 
 /** Release any data needed for background support. */
@@ -121,6 +217,7 @@ void SetBackground(int desktop, const char *type, const char *value)
 {
    static const StringMappingType mapping[] = {
       { "command",   BACKGROUND_COMMAND   },
+      { "fill",      BACKGROUND_FILL      },
       { "gradient",  BACKGROUND_GRADIENT  },
       { "image",     BACKGROUND_STRETCH   },
       { "scale",     BACKGROUND_SCALE     },
@@ -173,6 +270,10 @@ void SetBackground(int desktop, const char *type, const char *value)
    bp->type = bgType;
    bp->value = CopyString(value);
    bp->pixmap = None;
+   bp->state = BACKGROUND_READY;
+   bp->icon = NULL;
+   bp->image = NULL;
+   bp->fd = -1;
 
    /* Insert the node into the list. */
    bp->next = backgrounds;
@@ -189,14 +290,7 @@ void LoadBackground(int desktop)
    BackgroundNode *bp;
 
    /* Determine the background to load. */
-   for(bp = backgrounds; bp; bp = bp->next) {
-      if(bp->desktop == desktop) {
-         break;
-      }
-   }
-   if(!bp) {
-      bp = defaultBackground;
-   }
+   bp = GetDesktopBackground(desktop);
 
    /* If there is no background specified for this desktop, just return. */
    if(!bp || !bp->value) {
@@ -217,6 +311,18 @@ void LoadBackground(int desktop)
       return;
    }
 
+   /* Show a solid color until the image is ready.
+    * This background will be prepared next if it is still queued. */
+   if(bp->state != BACKGROUND_READY) {
+      StartBackgroundWorkers();
+      attrValues = CWBackPixel;
+      attr.background_pixel = 0;
+      JXChangeWindowAttributes(display, rootWindow, attrValues, &attr);
+      JXDeleteProperty(display, rootWindow, atoms[ATOM_XROOTPMAP_ID]);
+      JXClearWindow(display, rootWindow);
+      return;
+   }
+
    attrValues = CWBackPixmap;
    attr.background_pixmap = bp->pixmap;
    JXChangeWindowAttributes(display, rootWindow, attrValues, &attr);
@@ -225,6 +331,18 @@ void LoadBackground(int desktop)
 
 }
 
+/** Get the background for a desktop. */
+BackgroundNode *GetDesktopBackground(int desktop)
+{
+   BackgroundNode *bp;
+   for(bp = backgrounds; bp; bp = bp->next) {
+      if(bp->desktop == desktop) {
+         return bp;
+      }
+   }
+   return defaultBackground;
+}
+
 /** Load a gradient background. */
 void LoadGradientBackground(BackgroundNode *bp)
 {
@@ -279,31 +397,65 @@ void LoadGradientBackground(BackgroundNode *bp)
 
 }
 
-/** Load an image background. */
+/** Load an image background.
+ * The image is decoded and scaled by a worker process; see
+ * StartBackgroundWorkers.
+ */
 void LoadImageBackground(BackgroundNode *bp)
 {
 
-   IconNode *ip;
    int width, height;
 
-   /* Load the icon. */
+   /* Load the icon.
+    * This only reads the size of the image. */
    ExpandPath(&bp->value);
-   ip = LoadNamedIcon(bp->value, 0, bp->type == BACKGROUND_SCALE);
-   if(JUNLIKELY(!ip || ip->width == 0)) {
+   bp->icon = LoadNamedIcon(bp->value, 0, bp->type == BACKGROUND_SCALE);
+   if(JUNLIKELY(!bp->icon || bp->icon->width == 0)) {
+      bp->icon = NULL;
       bp->pixmap = None;
       Warning(_("background image not found: \"%s\""), bp->value);
       return;
    }
 
-   /* Determine the size of the background pixmap. */
-   if(bp->type == BACKGROUND_TILE) {
-      width = ip->width;
-      height = ip->height;
-   } else {
-      width = rootWidth;
-      height = rootHeight;
+   /* Use the pixmap rendered by an earlier run if possible. */
+   GetBackgroundPixmapSize(bp, &width, &height);
+   bp->pixmap = ReadPixmapCache(bp->icon->name, GetBackgroundKey(bp),
+                                width, height);
+   if(bp->pixmap != None) {
+      DestroyIcon(bp->icon);
+      bp->icon = NULL;
+      return;
+   }
+
+   /* Icons shared with other users are drawn directly. */
+   if(!bp->icon->transient) {
+      BuildImageBackground(bp);
+      return;
+   }
+   bp->state = BACKGROUND_QUEUED;
+
+}
+
+/** Create the pixmap for an image background. */
+void BuildImageBackground(BackgroundNode *bp)
+{
+
+   IconNode *ip = bp->icon;
+   char cache;
+   int width, height;
+
+   if(bp->type == BACKGROUND_FILL) {
+      BuildFillBackground(bp);
+      return;
    }
 
+   /* Determine the size of the background pixmap. */
+   GetBackgroundPixmapSize(bp, &width, &height);
+
+   /* Only cache images that were decoded by a worker; anything else
+    * may have failed to load. */
+   cache = ip->images != NULL;
+
    /* Create the pixmap. */
    bp->pixmap = JXCreatePixmap(display, rootWindow, width, height, rootDepth);
 
@@ -313,8 +465,511 @@ void LoadImageBackground(BackgroundNode *bp)
 
    /* Draw the icon on the background pixmap. */
    PutIcon(ip, bp->pixmap, 0, 0, 0, width, height);
+   if(cache) {
+      WritePixmapCache(ip->name, GetBackgroundKey(bp), bp->pixmap,
+                       width, height);
+   }
 
    /* We don't need the icon anymore. */
    DestroyIcon(ip);
+   bp->icon = NULL;
+
+}
+
+/** Get the size of the pixmap for an image background. */
+void GetBackgroundPixmapSize(const BackgroundNode *bp,
+                             int *width, int *height)
+{
+   if(bp->type == BACKGROUND_TILE) {
+      *width = bp->icon->width;
+      *height = bp->icon->height;
+   } else {
+      *width = rootWidth;
+      *height = rootHeight;
+   }
+}
+
+/** Get a key identifying how an image background is rendered.
+ * This covers the type and the screen layout.
+ */
+unsigned long GetBackgroundKey(const BackgroundNode *bp)
+{
+   const int count = GetScreenCount();
+   unsigned long key = bp->type;
+   int x;
+   key = key * 33 + rootWidth;
+   key = key * 33 + rootHeight;
+   for(x = 0; x < count; x++) {
+      const ScreenType *sp = GetScreen(x);
+      key = key * 33 + sp->x;
+      key = key * 33 + sp->y;
+      key = key * 33 + sp->width;
+      key = key * 33 + sp->height;
+   }
+   return key;
+}
+
+/** Get the size at which an image background will be drawn.
+ * This matches the size computed by PutIcon.
+ */
+void GetImageBackgroundSize(const BackgroundNode *bp, int *width, int *height)
+{
+   const IconNode *ip = bp->icon;
+   if(bp->type == BACKGROUND_TILE) {
+      *width = ip->width;
+      *height = ip->height;
+   } else if(bp->type == BACKGROUND_SCALE) {
+      const int ratio = (ip->width << 16) / ip->height;
+      *width = Min(rootWidth, (rootHeight * ratio) >> 16);
+      *height = Min(rootHeight, (*width << 16) / ratio);
+      *width = Max(1, (*height * ratio) >> 16);
+      *height = Max(1, *height);
+   } else {
+      *width = rootWidth;
+      *height = rootHeight;
+   }
+}
+
+/** Start workers for queued backgrounds.
+ * Backgrounds for the current desktop and the desktops closest to it
+ * are prepared first.
+ */
+void StartBackgroundWorkers(void)
+{
+   BackgroundNode *current = GetDesktopBackground(currentDesktop);
+   while(workerCount < MAX_BACKGROUND_WORKERS) {
+      BackgroundNode *best = NULL;
+      int bestDistance = 0;
+      BackgroundNode *bp;
+      for(bp = backgrounds; bp; bp = bp->next) {
+         if(bp->state == BACKGROUND_QUEUED) {
+            int distance;
+            if(bp == current) {
+               distance = 0;
+            } else if(bp->desktop < 0) {
+               distance = 1;
+            } else {
+               distance = abs(bp->desktop - (int)currentDesktop);
+            }
+            if(!best || distance < bestDistance) {
+               best = bp;
+               bestDistance = distance;
+            }
+         }
+      }
+      if(!best) {
+         break;
+      }
+      StartBackgroundWorker(best);
+   }
+}
+
+/** Start a worker to decode and scale an image background.
+ * If a worker cannot be started, the background is prepared directly.
+ */
+void StartBackgroundWorker(BackgroundNode *bp)
+{
+   int fds[2];
+   pid_t pid;
+
+   if(JUNLIKELY(pipe(fds) < 0)) {
+      BuildImageBackground(bp);
+      bp->state = BACKGROUND_READY;
+      return;
+   }
+   pid = fork();
+   if(pid == 0) {
+      close(ConnectionNumber(display));
+      close(fds[0]);
+      RunBackgroundWorker(bp, fds[1]);
+      _exit(EXIT_SUCCESS);
+   }
+   close(fds[1]);
+   if(JUNLIKELY(pid < 0)) {
+      close(fds[0]);
+      BuildImageBackground(bp);
+      bp->state = BACKGROUND_READY;
+      return;
+   }
+
+   fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+   fcntl(fds[0], F_SETFL, O_NONBLOCK);
+   bp->fd = fds[0];
+   bp->received = 0;
+   bp->record = 0;
+   bp->state = BACKGROUND_LOADING;
+   RegisterDescriptor(bp->fd, HandleBackgroundData, bp);
+   workerCount += 1;
+}
+
+/** Decode and scale an image background in a worker process. */
+void RunBackgroundWorker(const BackgroundNode *bp, int fd)
+{
+   ImageNode *image;
+   int width, height;
+
+   if(bp->type == BACKGROUND_FILL) {
+      RunFillWorker(bp, fd);
+      return;
+   }
 
+   GetImageBackgroundSize(bp, &width, &height);
+   image = LoadImage(bp->icon->name, width, height,
+                     bp->icon->preserveAspect);
+   if(image && image->bitmap) {
+      /* Leave bitmaps to the main process. */
+      DestroyImage(image);
+      image = NULL;
+   } else if(image && (image->width > width || image->height > height)) {
+      const int newWidth = Min(width, image->width);
+      const int newHeight = Min(height, image->height);
+      ImageNode *scaled = ResampleImage(image, 0, 0,
+                                        image->width, image->height,
+                                        newWidth, newHeight);
+      DestroyImage(image);
+      image = scaled;
+   }
+   SendBackgroundImage(fd, image);
+}
+
+/** Create the tiles for a fill background in a worker process.
+ * One image is sent for each screen. Screens whose tile is already
+ * cached get an empty image.
+ */
+void RunFillWorker(const BackgroundNode *bp, int fd)
+{
+   ImageNode *source = NULL;
+   const int count = GetScreenCount();
+   int x;
+   for(x = 0; x < count; x++) {
+      const ScreenType *sp = GetScreen(x);
+      const BackgroundTile *tp;
+      tp = FindTile(bp->icon->name, bp->type, sp->width, sp->height);
+      if(tp) {
+         tp = NULL;
+      } else {
+         if(!source) {
+            source = LoadFillSource(bp);
+            if(!source) {
+               break;
+            }
+         }
+         tp = CreateTile(bp->icon->name, bp->type, source,
+                         sp->width, sp->height);
+      }
+      if(!SendBackgroundImage(fd, tp ? tp->image : NULL)) {
+         break;
+      }
+   }
+   DestroyImage(source);
+}
+
+/** Send an image to the main process.
+ * The image is preceded by its size (zero if image is NULL).
+ */
+char SendBackgroundImage(int fd, const ImageNode *image)
+{
+   BackgroundHeader header;
+
+   memset(&header, 0, sizeof(header));
+   if(image) {
+      header.width = image->width;
+      header.height = image->height;
+   }
+   if(!WriteAll(fd, &header, sizeof(header))) {
+      return 0;
+   }
+   if(image) {
+      return WriteAll(fd, image->data, 4 * image->width * image->height);
+   }
+   return 1;
+}
+
+/** Write a buffer to a file descriptor, retrying after signals. */
+char WriteAll(int fd, const void *buffer, size_t length)
+{
+   const char *ptr = buffer;
+   while(length > 0) {
+      const ssize_t rc = write(fd, ptr, length);
+      if(rc < 0 && errno == EINTR) {
+         continue;
+      } else if(rc <= 0) {
+         return 0;
+      }
+      ptr += rc;
+      length -= rc;
+   }
+   return 1;
+}
+
+/** Receive data from a background worker. */
+void HandleBackgroundData(int fd, void *data)
+{
+   BackgroundNode *bp = (BackgroundNode*)data;
+   for(;;) {
+      char *ptr;
+      size_t length;
+      ssize_t rc;
+
+      if(bp->received < sizeof(bp->header)) {
+         ptr = (char*)&bp->header + bp->received;
+         length = sizeof(bp->header) - bp->received;
+      } else if(bp->image) {
+         const unsigned offset = bp->received - sizeof(bp->header);
+         ptr = (char*)bp->image->data + offset;
+         length = 4 * bp->image->width * bp->image->height - offset;
+      } else {
+         /* Empty image. */
+         if(!StoreBackgroundImage(bp)) {
+            return;
+         }
+         continue;
+      }
+
+      rc = read(fd, ptr, length);
+      if(rc < 0 && errno == EINTR) {
+         continue;
+      } else if(rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+         return;
+      } else if(rc <= 0) {
+         FinishImageBackground(bp);
+         return;
+      }
+      bp->received += rc;
+
+      if(bp->received == sizeof(bp->header)) {
+         if(bp->header.width > 0 && bp->header.height > 0) {
+            bp->image = CreateImage(bp->header.width, bp->header.height, 0);
+         }
+      } else if(bp->image && (size_t)rc == length) {
+         if(!StoreBackgroundImage(bp)) {
+            return;
+         }
+      }
+   }
+}
+
+/** Store an image received from a background worker.
+ * @return 1 if more images are expected, 0 if the worker is done.
+ */
+char StoreBackgroundImage(BackgroundNode *bp)
+{
+   ImageNode *image = bp->image;
+   int count = 1;
+
+   bp->image = NULL;
+   bp->received = 0;
+   if(bp->type == BACKGROUND_FILL) {
+      const ScreenType *sp = GetScreen(bp->record);
+      count = GetScreenCount();
+      if(image && image->width == sp->width && image->height == sp->height) {
+         InsertTile(bp->icon->name, bp->type, image);
+      } else {
+         DestroyImage(image);
+      }
+   } else if(image) {
+      /* The image is already at its final size. */
+      bp->icon->images = image;
+   }
+
+   bp->record += 1;
+   if(bp->record < count) {
+      return 1;
+   }
+   FinishImageBackground(bp);
+   return 0;
+}
+
+/** Create the pixmap for a background once its worker is done.
+ * Anything the worker did not send is prepared here instead.
+ */
+void FinishImageBackground(BackgroundNode *bp)
+{
+   UnregisterDescriptor(bp->fd);
+   close(bp->fd);
+   bp->fd = -1;
+   workerCount -= 1;
+
+   if(bp->image) {
+      DestroyImage(bp->image);
+      bp->image = NULL;
+   }
+   BuildImageBackground(bp);
+   bp->state = BACKGROUND_READY;
+
+   /* Show the background if it was waiting for this one. */
+   if(bp == lastBackground) {
+      lastBackground = NULL;
+      LoadBackground(currentDesktop);
+   }
+
+   StartBackgroundWorkers();
+}
+
+/** Create the pixmap for a fill background.
+ * Each screen gets a tile that is scaled to cover the screen and
+ * cropped to its size.
+ */
+void BuildFillBackground(BackgroundNode *bp)
+{
+   IconNode *ip = bp->icon;
+   ImageNode *source = NULL;
+   char loaded = 0;
+   char cache = 1;
+   const int count = GetScreenCount();
+   int x;
+
+   bp->pixmap = JXCreatePixmap(display, rootWindow, rootWidth, rootHeight,
+                               rootDepth);
+   JXSetForeground(display, rootGC, 0);
+   JXFillRectangle(display, bp->pixmap, rootGC, 0, 0, rootWidth, rootHeight);
+
+   for(x = 0; x < count; x++) {
+      const ScreenType *sp = GetScreen(x);
+      BackgroundTile *tp = FindTile(ip->name, bp->type,
+                                    sp->width, sp->height);
+      if(!tp && !loaded) {
+         source = LoadFillSource(bp);
+         loaded = 1;
+      }
+      if(!tp && source) {
+         tp = CreateTile(ip->name, bp->type, source, sp->width, sp->height);
+      }
+      if(tp) {
+         PutImage(tp->image, bp->pixmap, sp->x, sp->y);
+      } else {
+         /* Stretch images that cannot be scaled here (bitmaps). */
+         PutIcon(ip, bp->pixmap, 0, sp->x, sp->y, sp->width, sp->height);
+         cache = 0;
+      }
+   }
+   if(cache) {
+      WritePixmapCache(ip->name, GetBackgroundKey(bp), bp->pixmap,
+                       rootWidth, rootHeight);
+   }
+
+   /* The tiles are no longer needed once they are on the pixmap. */
+   ReleaseTiles(ip->name, bp->type);
+   DestroyImage(source);
+   DestroyIcon(ip);
+   bp->icon = NULL;
+}
+
+/** Decode the image for a fill background.
+ * The image is decoded at the smallest size that covers every screen.
+ * @return The image or NULL if it could not be decoded as ARGB.
+ */
+ImageNode *LoadFillSource(const BackgroundNode *bp)
+{
+   const IconNode *ip = bp->icon;
+   const int count = GetScreenCount();
+   ImageNode *image;
+   int width = 0;
+   int height = 0;
+   int x;
+
+   for(x = 0; x < count; x++) {
+      const ScreenType *sp = GetScreen(x);
+      int w, h;
+      if((long)sp->width * ip->height > (long)sp->height * ip->width) {
+         w = sp->width;
+         h = (int)(((long)sp->width * ip->height + ip->width - 1)
+                   / ip->width);
+      } else {
+         h = sp->height;
+         w = (int)(((long)sp->height * ip->width + ip->height - 1)
+                   / ip->height);
+      }
+      width = Max(width, w);
+      height = Max(height, h);
+   }
+
+   image = LoadImage(ip->name, width, height, 1);
+   if(image && image->bitmap) {
+      DestroyImage(image);
+      image = NULL;
+   }
+   return image;
+}
+
+/** Find a cached tile. */
+BackgroundTile *FindTile(const char *name, BackgroundType type,
+                         int width, int height)
+{
+   BackgroundTile *tp;
+   struct stat sbuf;
+   if(stat(name, &sbuf) != 0) {
+      return NULL;
+   }
+   for(tp = tiles; tp; tp = tp->next) {
+      if(   tp->type == type
+         && tp->image->width == width
+         && tp->image->height == height
+         && tp->mtime == (long)sbuf.st_mtime
+         && !strcmp(tp->name, name)) {
+         return tp;
+      }
+   }
+   return NULL;
+}
+
+/** Scale and crop an image to a screen size and cache the result. */
+BackgroundTile *CreateTile(const char *name, BackgroundType type,
+                           const ImageNode *source, int width, int height)
+{
+   ImageNode *image;
+   int x, y, w, h;
+
+   /* Crop the source to the aspect ratio of the screen. */
+   if((long)source->width * height > (long)source->height * width) {
+      h = source->height;
+      w = Max(1, (int)(((long)h * width) / height));
+   } else {
+      w = source->width;
+      h = Max(1, (int)(((long)w * height) / width));
+   }
+   x = (source->width - w) / 2;
+   y = (source->height - h) / 2;
+
+   image = ResampleImage(source, x, y, w, h, width, height);
+   return InsertTile(name, type, image);
+}
+
+/** Add a tile to the cache.
+ * The tile takes ownership of the image.
+ */
+BackgroundTile *InsertTile(const char *name, BackgroundType type,
+                           ImageNode *image)
+{
+   BackgroundTile *tp;
+   struct stat sbuf;
+
+   tp = Allocate(sizeof(BackgroundTile));
+   tp->name = CopyString(name);
+   tp->mtime = stat(name, &sbuf) == 0 ? (long)sbuf.st_mtime : 0;
+   tp->type = type;
+   tp->image = image;
+   tp->next = tiles;
+   tiles = tp;
+   return tp;
+}
+
+/** Release cached tiles.
+ * @param name The file name of the tiles to release (NULL for all).
+ * @param type The type of background of the tiles to release.
+ */
+void ReleaseTiles(const char *name, BackgroundType type)
+{
+   BackgroundTile **tpp = &tiles;
+   while(*tpp) {
+      BackgroundTile *tp = *tpp;
+      if(!name || (tp->type == type && !strcmp(tp->name, name))) {
+         *tpp = tp->next;
+         Release(tp->name);
+         DestroyImage(tp->image);
+         Release(tp);
+      } else {
+         tpp = &tp->next;
+      }
+   }
 }
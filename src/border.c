@@ -425,7 +425,8 @@ void DrawBorderHelper(const ClientNode *np)
 
       if(np->name && np->name[0] && titleWidth > 0) {
          const int sheight = GetStringHeight(FONT_BORDER);
-         const int textWidth = GetStringWidth(FONT_BORDER, np->name);
+         const int textWidth = GetPreparedTextWidth(FONT_BORDER,
+                                                    &np->title);
          unsigned titlex, titley;
          int xoffset = 0;
          switch (settings.titleTextAlignment) {
@@ -440,8 +441,8 @@ void DrawBorderHelper(const ClientNode *np)
          titlex = startx + titleHeight + xoffset
                 + (settings.windowDecorations == DECO_MOTIF ? 4 : 0);
          titley = starty + (titleHeight - sheight) / 2;
-         RenderString(canvas, FONT_BORDER, borderTextColor,
-                      titlex, titley, titleWidth, np->name);
+         RenderPreparedText(canvas, FONT_BORDER, borderTextColor,
+                            titlex, titley, titleWidth, &np->title);
       }
 
       DrawBorderButtons(np, canvas, gc);
@@ -1361,5 +1362,6 @@ void SetBorderIcon(BorderIconType t, const char *name)
       Release(buttonNames[t]);
    }
    buttonNames[t] = CopyString(name);
+   PreloadIcon(name);
 }
  
@@ -159,8 +159,12 @@ void DrawButton(ButtonNode *bp)
    /* Determine how much room is left for text. */
    textWidth = 0;
    textHeight = 0;
-   if(bp->text && (width > height || !bp->icon)) {
-      textWidth = GetStringWidth(bp->font, bp->text);
+   if((bp->text || bp->title) && (width > height || !bp->icon)) {
+      if(bp->title) {
+         textWidth = GetPreparedTextWidth(bp->font, bp->title);
+      } else {
+         textWidth = GetStringWidth(bp->font, bp->text);
+      }
       textHeight = GetStringHeight(bp->font);
       if(iconWidth > 0 && textWidth + iconWidth + 7 > width) {
          textWidth = width - iconWidth - 7;
@@ -192,9 +196,15 @@ void DrawButton(ButtonNode *bp)
    /* Display the label. */
    if(textWidth > 0) {
       yoffset = (height - textHeight + 1) / 2;
-      RenderString(drawable, bp->font, fg,
-                   x + xoffset, y + yoffset,
-                   textWidth, bp->text);
+      if(bp->title) {
+         RenderPreparedText(drawable, bp->font, fg,
+                            x + xoffset, y + yoffset,
+                            textWidth, bp->title);
+      } else {
+         RenderString(drawable, bp->font, fg,
+                      x + xoffset, y + yoffset,
+                      textWidth, bp->text);
+      }
    }
 
    JXFreeGC(display, gc);
@@ -217,6 +227,7 @@ void ResetButton(ButtonNode *bp, Drawable d)
    bp->height = 1;
    bp->icon = NULL;
    bp->text = NULL;
+   bp->title = NULL;
    bp->fill = 1;
    bp->border = 0;
 
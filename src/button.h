@@ -41,6 +41,7 @@ typedef struct {
 
    struct IconNode *icon;     /**< Icon used in the button. */
    const char *text;          /**< Text used in the button. */
+   const PreparedText *title; /**< Prepared text used instead of text. */
 
 } ButtonNode;
 
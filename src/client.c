@@ -18,6 +18,7 @@
 #include "taskbar.h"
 #include "screen.h"
 #include "pager.h"
+#include "thumbnail.h"
 #include "color.h"
 #include "place.h"
 #include "event.h"
@@ -1202,6 +1203,7 @@ void RemoveClient(ClientNode *np)
       nodes[np->state.layer] = np->next;
    }
    clientCount -= 1;
+   RemoveThumbnail(np);
    XDeleteContext(display, np->window, clientContext);
    if(np->parent != None) {
       XDeleteContext(display, np->parent, frameContext);
@@ -1253,6 +1255,7 @@ void RemoveClient(ClientNode *np)
    if(np->name) {
       Release(np->name);
    }
+   ReleasePreparedText(&np->title);
    if(np->instanceName) {
       JXFree(np->instanceName);
    }
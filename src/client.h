@@ -13,6 +13,7 @@
 #include "main.h"
 #include "border.h"
 #include "hint.h"
+#include "font.h"
 
 struct TimeType;
 
@@ -142,6 +143,7 @@ typedef struct ClientNode {
    ColormapNode *colormaps;   /**< Colormaps assigned to this window. */
 
    char *name;                /**< Name of this window for display. */
+   PreparedText title;        /**< Name prepared for rendering. */
    char *instanceName;        /**< Name of this window for properties. */
    char *className;           /**< Name of the window class. */
 
@@ -29,13 +29,12 @@ typedef struct ClockType {
 
    char *format;                 /**< The time format to use. */
    char *zone;                   /**< The time zone to use (NULL = local). */
+   TimeFormatType *timeFormat;   /**< Precompiled format. */
    struct ActionType *actions;   /**< Actions */
-   TimeType lastTime;            /**< Currently displayed time. */
-
-   /* The following are used to control popups. */
-   int mousex;                /**< Last mouse x-coordinate. */
-   int mousey;                /**< Last mouse y-coordinate. */
-   TimeType mouseTime;        /**< Time of the last mouse motion. */
+   char redraw;                  /**< Set to draw an unchanged time. */
+   Pixmap background;            /**< Cached background. */
+   char *text;                   /**< The text drawn (NULL if none). */
+   int textWidth;                /**< Width of the text drawn. */
 
    int userWidth;             /**< User-specified clock width (or 0). */
 
@@ -59,9 +58,11 @@ static void ProcessClockMotionEvent(TrayComponentType *cp,
                                     int x, int y, int mask);
 
 static void DrawClock(ClockType *clk, const TimeType *now);
+static void DrawClockBackground(ClockType *clk);
 
 static void SignalClock(const struct TimeType *now, int x, int y, Window w,
                         void *data);
+static void ShowClockPopup(void *data, int x, int y);
 
 
 /** Initialize clocks. */
@@ -96,6 +97,10 @@ void DestroyClock(void)
       if(clocks->zone) {
          Release(clocks->zone);
       }
+      if(clocks->text) {
+         Release(clocks->text);
+      }
+      DestroyTimeFormat(clocks->timeFormat);
       DestroyActions(clocks->actions);
       UnregisterCallback(SignalClock, clocks);
 
@@ -116,10 +121,6 @@ TrayComponentType *CreateClock(const char *format, const char *zone,
    clk->next = clocks;
    clocks = clk;
 
-   clk->mousex = -settings.doubleClickDelta;
-   clk->mousey = -settings.doubleClickDelta;
-   clk->mouseTime.seconds = 0;
-   clk->mouseTime.ms = 0;
    clk->userWidth = 0;
 
    if(!format) {
@@ -127,8 +128,12 @@ TrayComponentType *CreateClock(const char *format, const char *zone,
    }
    clk->format = CopyString(format);
    clk->zone = CopyString(zone);
+   clk->timeFormat = CreateTimeFormat(clk->format, clk->zone);
    clk->actions = NULL;
-   memset(&clk->lastTime, 0, sizeof(clk->lastTime));
+   clk->redraw = 1;
+   clk->background = None;
+   clk->text = NULL;
+   clk->textWidth = 0;
 
    cp = CreateTrayComponent();
    cp->object = clk;
@@ -149,7 +154,7 @@ TrayComponentType *CreateClock(const char *format, const char *zone,
    cp->ProcessButtonRelease = ProcessClockButtonRelease;
    cp->ProcessMotionEvent = ProcessClockMotionEvent;
 
-   RegisterCallback(Min(900, settings.popupDelay / 2), SignalClock, clk);
+   RegisterCallback(900, SignalClock, clk);
 
    return cp;
 }
@@ -166,8 +171,11 @@ void AddClockAction(TrayComponentType *cp,
 /** Initialize a clock tray component. */
 void Create(TrayComponentType *cp)
 {
+   ClockType *clk = (ClockType*)cp->object;
    cp->pixmap = JXCreatePixmap(display, rootWindow, cp->width, cp->height,
                                rootDepth);
+   DrawClockBackground(clk);
+   clk->redraw = 1;
 }
 
 /** Resize a clock tray component. */
@@ -189,8 +197,9 @@ void Resize(TrayComponentType *cp)
 
    cp->pixmap = JXCreatePixmap(display, rootWindow, cp->width, cp->height,
                                rootDepth);
+   DrawClockBackground(clk);
 
-   memset(&clk->lastTime, 0, sizeof(clk->lastTime));
+   clk->redraw = 1;
 
    GetCurrentTime(&now);
    DrawClock(clk, &now);
@@ -200,10 +209,16 @@ void Resize(TrayComponentType *cp)
 /** Destroy a clock tray component. */
 void Destroy(TrayComponentType *cp)
 {
+   ClockType *clk;
    Assert(cp);
+   clk = (ClockType*)cp->object;
    if(cp->pixmap != None) {
       JXFreePixmap(display, cp->pixmap);
    }
+   if(clk->background != None) {
+      JXFreePixmap(display, clk->background);
+      clk->background = None;
+   }
 }
 
 /** Process a press event on a clock tray component. */
@@ -223,10 +238,8 @@ void ProcessClockButtonRelease(TrayComponentType *cp, int x, int y, int button)
 void ProcessClockMotionEvent(TrayComponentType *cp,
                              int x, int y, int mask)
 {
-   ClockType *clk = (ClockType*)cp->object;
-   clk->mousex = cp->screenx + x;
-   clk->mousey = cp->screeny + y;
-   GetCurrentTime(&clk->mouseTime);
+   UpdatePopupHover(ShowClockPopup, cp->object, cp->tray->window,
+                    cp->screenx + x, cp->screeny + y);
 }
 
 /** Update a clock tray component. */
@@ -234,66 +247,127 @@ void SignalClock(const TimeType *now, int x, int y, Window w, void *data)
 {
 
    ClockType *cp = (ClockType*)data;
-   const char *longTime;
-
    DrawClock(cp, now);
-   if(cp->cp->tray->window == w &&
-      abs(cp->mousex - x) < settings.doubleClickDelta &&
-      abs(cp->mousey - y) < settings.doubleClickDelta) {
-      if(GetTimeDifference(now, &cp->mouseTime) >= settings.popupDelay) {
-         longTime = GetTimeString("%c", cp->zone);
-         ShowPopup(x, y, longTime, POPUP_CLOCK);
-      }
-   }
 
 }
 
-/** Draw a clock tray component. */
+/** Show the popup for a clock tray component. */
+void ShowClockPopup(void *data, int x, int y)
+{
+   const ClockType *clk = (ClockType*)data;
+   ShowPopup(x, y, GetTimeString("%c", clk->zone), POPUP_CLOCK);
+}
+
+/** Draw the cached background of a clock tray component. */
+void DrawClockBackground(ClockType *clk)
+{
+   const TrayComponentType *cp = clk->cp;
+   if(clk->background != None) {
+      JXFreePixmap(display, clk->background);
+   }
+   clk->background = JXCreatePixmap(display, rootWindow,
+                                    cp->width, cp->height, rootDepth);
+   if(colors[COLOR_CLOCK_BG1] == colors[COLOR_CLOCK_BG2]) {
+      JXSetForeground(display, rootGC, colors[COLOR_CLOCK_BG1]);
+      JXFillRectangle(display, clk->background, rootGC, 0, 0,
+                      cp->width, cp->height);
+   } else {
+      DrawHorizontalGradient(clk->background, rootGC,
+                             colors[COLOR_CLOCK_BG1], colors[COLOR_CLOCK_BG2],
+                             0, 0, cp->width, cp->height);
+   }
+}
+
+/** Draw a clock tray component.
+ * If the text has the same length and width as the text already drawn,
+ * only the characters that changed are drawn.
+ */
 void DrawClock(ClockType *clk, const TimeType *now)
 {
 
    TrayComponentType *cp;
    const char *timeString;
+   int *offsets;
+   int len;
    int width;
    int rwidth;
+   int x, y;
+   int first, last;
+   char haveOffsets;
 
-   /* Only draw if the time changed. */
-   if(now->seconds == clk->lastTime.seconds) {
+   /* Only draw if the time string changed. */
+   if(!UpdateTimeFormat(clk->timeFormat, now) && !clk->redraw) {
       return;
    }
 
-   /* Clear the area. */
+   /* Determine the width, from the character widths if possible. */
    cp = clk->cp;
-   if(colors[COLOR_CLOCK_BG1] == colors[COLOR_CLOCK_BG2]) {
-      JXSetForeground(display, rootGC, colors[COLOR_CLOCK_BG1]);
-      JXFillRectangle(display, cp->pixmap, rootGC, 0, 0,
-                      cp->width, cp->height);
+   timeString = GetTimeFormatString(clk->timeFormat);
+   len = strlen(timeString);
+   offsets = AllocateStack(sizeof(int) * (len + 1));
+   haveOffsets = GetCharacterOffsets(FONT_CLOCK, timeString, offsets);
+   if(haveOffsets) {
+      width = offsets[len];
    } else {
-      DrawHorizontalGradient(cp->pixmap, rootGC,
-                             colors[COLOR_CLOCK_BG1], colors[COLOR_CLOCK_BG2],
-                             0, 0, cp->width, cp->height);
+      width = GetStringWidth(FONT_CLOCK, timeString);
    }
 
    /* Determine if the clock is the right size. */
-   timeString = GetTimeString(clk->format, clk->zone);
-   width = GetStringWidth(FONT_CLOCK, timeString);
    rwidth = width + 4;
-   if(rwidth == clk->cp->requestedWidth || clk->userWidth) {
+   if(rwidth != clk->cp->requestedWidth && !clk->userWidth) {
 
-      /* Draw the clock. */
-      RenderString(cp->pixmap, FONT_CLOCK, COLOR_CLOCK_FG,
-                   (cp->width - width) / 2,
-                   (cp->height - GetStringHeight(FONT_CLOCK)) / 2,
-                   cp->width, timeString);
+      /* Wrong size. Resize. */
+      clk->cp->requestedWidth = rwidth;
+      clk->redraw = 1;
+      ReleaseStack(offsets);
+      ResizeTray(clk->cp->tray);
+      return;
 
-      UpdateSpecificTray(clk->cp->tray, clk->cp);
+   }
+
+   x = (cp->width - width) / 2;
+   y = (cp->height - GetStringHeight(FONT_CLOCK)) / 2;
+   if(   !clk->redraw && haveOffsets && clk->text && x >= 0
+      && width == clk->textWidth && len == (int)strlen(clk->text)) {
+
+      /* Same layout: only draw the characters that changed. */
+      first = 0;
+      while(first < len && timeString[first] == clk->text[first]) {
+         first += 1;
+      }
+      last = len - 1;
+      while(last > first && timeString[last] == clk->text[last]) {
+         last -= 1;
+      }
+      if(first < len) {
+         const int left = x + offsets[first];
+         const int right = x + offsets[last + 1];
+         JXCopyArea(display, clk->background, cp->pixmap, rootGC,
+                    left, 0, right - left, cp->height, left, 0);
+         RenderStringPart(cp->pixmap, FONT_CLOCK, COLOR_CLOCK_FG,
+                          x, y, left, right - left, timeString);
+         UpdateSpecificTrayArea(cp->tray, cp, left, 0,
+                                right - left, cp->height);
+      }
 
    } else {
 
-      /* Wrong size. Resize. */
-      clk->cp->requestedWidth = rwidth;
-      ResizeTray(clk->cp->tray);
+      /* Draw the whole clock. */
+      JXCopyArea(display, clk->background, cp->pixmap, rootGC,
+                 0, 0, cp->width, cp->height, 0, 0);
+      RenderString(cp->pixmap, FONT_CLOCK, COLOR_CLOCK_FG, x, y,
+                   cp->width, timeString);
+      UpdateSpecificTray(clk->cp->tray, clk->cp);
+
+   }
+   ReleaseStack(offsets);
 
+   /* Remember what was drawn. */
+   if(clk->text) {
+      Release(clk->text);
    }
+   clk->text = CopyString(timeString);
+   clk->textWidth = width;
+   clk->redraw = 0;
 
 }
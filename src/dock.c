@@ -28,7 +28,10 @@ typedef struct DockNode {
    Window window;
    char needs_reparent;
 
-   struct DockNode *next;
+   /* Geometry last given to the window (x is -1 if not placed). */
+   int x, y;            /**< Location in the dock. */
+   int size;            /**< Width and height. */
+   int rootx, rooty;    /**< Location on the root window. */
 
 } DockNode;
 
@@ -40,7 +43,9 @@ typedef struct DockType {
    Window window;
    int itemSize;
 
-   DockNode *nodes;
+   DockNode *nodes;        /**< Docked windows in dock order. */
+   unsigned nodeCount;     /**< Number of docked windows. */
+   unsigned nodeCapacity;  /**< Number of nodes allocated. */
 
 } DockType;
 
@@ -54,9 +59,12 @@ static unsigned long orientation;
 static void SetSize(TrayComponentType *cp, int width, int height);
 static void Create(TrayComponentType *cp);
 static void Resize(TrayComponentType *cp);
+static void Move(TrayComponentType *cp);
 
 static void DockWindow(Window win);
+static int FindDockNode(Window win);
 static void UpdateDock(void);
+static void UpdateDockNode(DockNode *np, int x, int y, int size, char force);
 static void GetDockItemSize(int *size);
 static void GetDockSize(int *width, int *height);
 
@@ -108,17 +116,20 @@ void StartupDock(void)
 void ShutdownDock(void)
 {
 
-   DockNode *np;
+   unsigned i;
 
    if(dock) {
 
       /* Release memory used by the dock list. */
-      while(dock->nodes) {
-         np = dock->nodes->next;
-         JXReparentWindow(display, dock->nodes->window, rootWindow, 0, 0);
+      for(i = 0; i < dock->nodeCount; i++) {
+         JXReparentWindow(display, dock->nodes[i].window, rootWindow, 0, 0);
+      }
+      if(dock->nodes) {
          Release(dock->nodes);
-         dock->nodes = np;
+         dock->nodes = NULL;
       }
+      dock->nodeCount = 0;
+      dock->nodeCapacity = 0;
 
       /* Release the selection. */
       if(owner) {
@@ -152,6 +163,8 @@ TrayComponentType *CreateDock(int width)
    } else if(dock == NULL) {
       dock = Allocate(sizeof(DockType));
       dock->nodes = NULL;
+      dock->nodeCount = 0;
+      dock->nodeCapacity = 0;
       dock->window = None;
    }
 
@@ -165,6 +178,7 @@ TrayComponentType *CreateDock(int width)
    cp->SetSize = SetSize;
    cp->Create = Create;
    cp->Resize = Resize;
+   cp->Move = Move;
 
    return cp;
 
@@ -258,6 +272,12 @@ void Resize(TrayComponentType *cp)
    UpdateDock();
 }
 
+/** Update docked windows after the dock moved. */
+void Move(TrayComponentType *cp)
+{
+   UpdateDock();
+}
+
 /** Handle a dock event. */
 void HandleDockEvent(const XClientMessageEvent *event)
 {
@@ -279,7 +299,7 @@ void HandleDockEvent(const XClientMessageEvent *event)
 /** Handle a resize request event. */
 char HandleDockResizeRequest(const XResizeRequestEvent *event)
 {
-   DockNode *np;
+   int index;
 
    Assert(event);
 
@@ -287,11 +307,14 @@ char HandleDockResizeRequest(const XResizeRequestEvent *event)
       return 0;
    }
 
-   for(np = dock->nodes; np; np = np->next) {
-      if(np->window == event->window) {
-         UpdateDock();
-         return 1;
+   /* Docked windows keep the size of their slot. */
+   index = FindDockNode(event->window);
+   if(index >= 0) {
+      DockNode *np = &dock->nodes[index];
+      if(np->x >= 0) {
+         UpdateDockNode(np, np->x, np->y, np->size, 1);
       }
+      return 1;
    }
 
    return 0;
@@ -301,7 +324,7 @@ char HandleDockResizeRequest(const XResizeRequestEvent *event)
 char HandleDockConfigureRequest(const XConfigureRequestEvent *event)
 {
 
-   DockNode *np;
+   int index;
 
    Assert(event);
 
@@ -309,11 +332,13 @@ char HandleDockConfigureRequest(const XConfigureRequestEvent *event)
       return 0;
    }
 
-   for(np = dock->nodes; np; np = np->next) {
-      if(np->window == event->window) {
-         UpdateDock();
-         return 1;
+   index = FindDockNode(event->window);
+   if(index >= 0) {
+      DockNode *np = &dock->nodes[index];
+      if(np->x >= 0) {
+         UpdateDockNode(np, np->x, np->y, np->size, 1);
       }
+      return 1;
    }
 
    return 0;
@@ -324,8 +349,7 @@ char HandleDockConfigureRequest(const XConfigureRequestEvent *event)
 char HandleDockReparentNotify(const XReparentEvent *event)
 {
 
-   DockNode *np;
-   char handled;
+   int index;
 
    Assert(event);
 
@@ -334,28 +358,22 @@ char HandleDockReparentNotify(const XReparentEvent *event)
       return 0;
    }
 
-   /* Check each docked window. */
-   handled = 0;
-   for(np = dock->nodes; np; np = np->next) {
-      if(np->window == event->window) {
-         if(event->parent != dock->cp->window) {
-            /* For some reason the application reparented the window.
-             * We make note of this condition and reparent every time
-             * the dock is updated. Unfortunately we can't do this for
-             * all applications because some won't deal with it.
-             */
-            np->needs_reparent = 1;
-            handled = 1;
-         }
+   index = FindDockNode(event->window);
+   if(index >= 0 && event->parent != dock->cp->window) {
+      /* For some reason the application reparented the window.
+       * We make note of this condition and reparent every time
+       * the window is configured. Unfortunately we can't do this for
+       * all applications because some won't deal with it.
+       */
+      DockNode *np = &dock->nodes[index];
+      np->needs_reparent = 1;
+      if(np->x >= 0) {
+         UpdateDockNode(np, np->x, np->y, np->size, 1);
       }
+      return 1;
    }
 
-   /* Layout the stuff on the dock again if something happened. */
-   if(handled) {
-      UpdateDock();
-   }
-
-   return handled;
+   return 0;
 
 }
 
@@ -385,70 +403,98 @@ void DockWindow(Window win)
    }
 
    /* If this window is already docked ignore it. */
-   for(np = dock->nodes; np; np = np->next) {
-      if(np->window == win) {
-         return;
-      }
+   if(FindDockNode(win) >= 0) {
+      return;
    }
 
-   /* Add the window to our list. */
-   np = Allocate(sizeof(DockNode));
+   /* Add the window to the end of the dock so that other windows
+    * keep their slots. */
+   if(dock->nodeCount == dock->nodeCapacity) {
+      dock->nodeCapacity = Max(16, dock->nodeCapacity * 2);
+      if(dock->nodes) {
+         dock->nodes = Reallocate(dock->nodes,
+                                  dock->nodeCapacity * sizeof(DockNode));
+      } else {
+         dock->nodes = Allocate(dock->nodeCapacity * sizeof(DockNode));
+      }
+   }
+   np = &dock->nodes[dock->nodeCount];
+   dock->nodeCount += 1;
    np->window = win;
    np->needs_reparent = 0;
-   np->next = dock->nodes;
-   dock->nodes = np;
+   np->x = -1;
+   np->y = -1;
+   np->size = 0;
+   np->rootx = 0;
+   np->rooty = 0;
 
    /* Update the requested size. */
    GetDockSize(&dock->cp->requestedWidth, &dock->cp->requestedHeight);
 
-   /* It's safe to reparent at (0, 0) since we call
-    * ResizeTray which will invoke the Resize callback.
+   /* It's safe to reparent at (0, 0) since the window is placed
+    * by UpdateDock below.
     */
    JXAddToSaveSet(display, win);
    JXReparentWindow(display, win, dock->cp->window, 0, 0);
    JXMapRaised(display, win);
 
-   /* Resize the tray containing the dock. */
+   /* Resize the tray containing the dock.
+    * This updates the dock if its size changed; otherwise only the
+    * new window needs to be placed. */
    ResizeTray(dock->cp->tray);
+   UpdateDock();
 
 }
 
 /** Remove a window from the dock. */
 char HandleDockDestroy(Window win)
 {
-   DockNode **np;
+   int index;
 
    /* If no dock is running, just return. */
    if(!dock) {
       return 0;
    }
 
-   for(np = &dock->nodes; *np; np = &(*np)->next) {
-      DockNode *dp = *np;
-      if(dp->window == win) {
+   index = FindDockNode(win);
+   if(index < 0) {
+      return 0;
+   }
 
-         /* Remove the window from our list. */
-         *np = dp->next;
-         Release(dp);
+   /* Remove the window from our list.
+    * Windows after it move down a slot. */
+   dock->nodeCount -= 1;
+   memmove(&dock->nodes[index], &dock->nodes[index + 1],
+           (dock->nodeCount - index) * sizeof(DockNode));
 
-         /* Update the requested size. */
-         GetDockSize(&dock->cp->requestedWidth, &dock->cp->requestedHeight);
+   /* Update the requested size. */
+   GetDockSize(&dock->cp->requestedWidth, &dock->cp->requestedHeight);
 
-         /* Resize the tray. */
-         ResizeTray(dock->cp->tray);
-         return 1;
+   /* Resize the tray and move the windows that changed slots. */
+   ResizeTray(dock->cp->tray);
+   UpdateDock();
+   return 1;
+}
+
+/** Find the index of a docked window (-1 if not docked). */
+int FindDockNode(Window win)
+{
+   unsigned i;
+   for(i = 0; i < dock->nodeCount; i++) {
+      if(dock->nodes[i].window == win) {
+         return i;
       }
    }
-
-   return 0;
+   return -1;
 }
 
-/** Layout items on the dock. */
+/** Layout items on the dock.
+ * Only windows whose slot (or the dock location) changed are updated.
+ */
 void UpdateDock(void)
 {
 
-   XConfigureEvent event;
-   DockNode *np;
+   unsigned i;
    int x, y;
    int itemSize;
 
@@ -459,34 +505,66 @@ void UpdateDock(void)
 
    x = 0;
    y = 0;
-   memset(&event, 0, sizeof(event));
-   for(np = dock->nodes; np; np = np->next) {
+   for(i = 0; i < dock->nodeCount; i++) {
+      UpdateDockNode(&dock->nodes[i], x, y, itemSize, 0);
+      if(orientation == SYSTEM_TRAY_ORIENTATION_HORZ) {
+         x += itemSize;
+      } else {
+         y += itemSize;
+      }
+   }
+
+}
+
+/** Place a window on the dock.
+ * @param np The docked window.
+ * @param x The x-coordinate in the dock.
+ * @param y The y-coordinate in the dock.
+ * @param size The width and height of the window.
+ * @param force Set to configure the window even if nothing changed.
+ */
+void UpdateDockNode(DockNode *np, int x, int y, int size, char force)
+{
+
+   XConfigureEvent event;
+   const int rootx = dock->cp->screenx + x;
+   const int rooty = dock->cp->screeny + y;
 
-      JXMoveResizeWindow(display, np->window, x, y, itemSize, itemSize);
+   if(force || np->needs_reparent
+      || np->x != x || np->y != y || np->size != size) {
+
+      JXMoveResizeWindow(display, np->window, x, y, size, size);
 
       /* Reparent if this window likes to go other places. */
       if(np->needs_reparent) {
          JXReparentWindow(display, np->window, dock->cp->window, x, y);
       }
 
-      event.type = ConfigureNotify;
-      event.event = np->window;
-      event.window = np->window;
-      event.x = dock->cp->screenx + x;
-      event.y = dock->cp->screeny + y;
-      event.width = itemSize;
-      event.height = itemSize;
-      JXSendEvent(display, np->window, False, StructureNotifyMask,
-                  (XEvent*)&event);
+   } else if(np->rootx == rootx && np->rooty == rooty) {
 
-      if(orientation == SYSTEM_TRAY_ORIENTATION_HORZ) {
-         x += itemSize;
-      } else {
-         y += itemSize;
-      }
+      /* The window did not move. */
+      return;
 
    }
 
+   /* Tell the window where it is on the root window. */
+   memset(&event, 0, sizeof(event));
+   event.type = ConfigureNotify;
+   event.event = np->window;
+   event.window = np->window;
+   event.x = rootx;
+   event.y = rooty;
+   event.width = size;
+   event.height = size;
+   JXSendEvent(display, np->window, False, StructureNotifyMask,
+               (XEvent*)&event);
+
+   np->x = x;
+   np->y = y;
+   np->size = size;
+   np->rootx = rootx;
+   np->rooty = rooty;
+
 }
 
 /** Get the size of a particular window on the dock. */
@@ -506,7 +584,6 @@ void GetDockItemSize(int *size)
 /** Get the size of the dock. */
 void GetDockSize(int *width, int *height)
 {
-   DockNode *np;
    int itemSize;
 
    Assert(dock != NULL);
@@ -515,14 +592,12 @@ void GetDockSize(int *width, int *height)
    GetDockItemSize(&itemSize);
 
    /* Determine the size of the items on the dock. */
-   for(np = dock->nodes; np; np = np->next) {
-      if(orientation == SYSTEM_TRAY_ORIENTATION_HORZ) {
-         /* Horizontal tray; height fixed, placement is left to right. */
-         *width += itemSize;
-      } else {
-         /* Vertical tray; width fixed, placement is top to bottom. */
-         *height += itemSize;
-      }
+   if(orientation == SYSTEM_TRAY_ORIENTATION_HORZ) {
+      /* Horizontal tray; height fixed, placement is left to right. */
+      *width += itemSize * dock->nodeCount;
+   } else {
+      /* Vertical tray; width fixed, placement is top to bottom. */
+      *height += itemSize * dock->nodeCount;
    }
 
    /* Don't allow the dock to have zero size since a size of
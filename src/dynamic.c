@@ -0,0 +1,318 @@
+/**
+ * @file dynamic.c
+ *
+ * @brief Dynamic menus (generated by a file or program).
+ *
+ * Programs generating a menu are started when the menu containing the
+ * dynamic item is shown. The output is read without blocking the event
+ * loop and the submenu is attached to the item once it is parsed.
+ * Menus with a time limit or a file dependency are kept between uses.
+ *
+ */
+
+#include "jwm.h"
+#include "dynamic.h"
+#include "menu.h"
+#include "parse.h"
+#include "event.h"
+#include "timing.h"
+#include "misc.h"
+#include "main.h"
+#include "error.h"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+
+/** Initial size of the buffer for program output. */
+#define DYNAMIC_BUFFER_SIZE 4096
+
+/** Structure to represent a dynamic menu. */
+struct DynamicMenu {
+   char *command;             /**< File or program generating the menu. */
+   char *depends;             /**< File the menu depends on (or NULL). */
+   unsigned long ttl;         /**< Seconds to keep the menu. */
+   int height;                /**< Item height for the menu. */
+   char cached;               /**< Set if the menu is kept between uses. */
+
+   Menu *menu;                /**< The generated menu (or NULL). */
+   MenuItem *item;            /**< Item showing the menu (or NULL). */
+   TimeType loaded;           /**< Time the menu was generated. */
+   long mtime;                /**< Modification time of depends. */
+
+   int fd;                    /**< Pipe from the program (-1 if none). */
+   char *buffer;              /**< Output read from the program. */
+   unsigned length;           /**< Bytes in the buffer. */
+   unsigned size;             /**< Size of the buffer. */
+
+   struct DynamicMenu *next;  /**< Next dynamic menu in the list. */
+};
+
+static DynamicMenu *dynamicMenus = NULL;
+
+static char IsDynamicMenuCurrent(const DynamicMenu *dp);
+static long GetDependsTime(const DynamicMenu *dp);
+static void StartDynamicMenu(DynamicMenu *dp);
+static void HandleDynamicData(int fd, void *data);
+static void FinishDynamicMenu(DynamicMenu *dp);
+static void SetDynamicMenu(DynamicMenu *dp, Menu *menu);
+static void ReleaseDynamicMenuData(DynamicMenu *dp);
+
+/** Shutdown dynamic menus. */
+void ShutdownDynamicMenus(void)
+{
+   DynamicMenu *dp = dynamicMenus;
+   while(dp) {
+      if(dp->menu || dp->fd >= 0) {
+         /* Destroying a menu also destroys the dynamic menus it
+          * contains, so start over from the beginning of the list. */
+         ReleaseDynamicMenuData(dp);
+         dp = dynamicMenus;
+      } else {
+         dp = dp->next;
+      }
+   }
+}
+
+/** Create a dynamic menu. */
+DynamicMenu *CreateDynamicMenu(const char *command, int height,
+                               unsigned ttl, const char *depends)
+{
+   DynamicMenu *dp = Allocate(sizeof(DynamicMenu));
+   dp->command = CopyString(command);
+   dp->depends = CopyString(depends);
+   if(dp->depends) {
+      ExpandPath(&dp->depends);
+   }
+   dp->ttl = ttl;
+   dp->height = height;
+   dp->cached = ttl > 0 || depends != NULL;
+   dp->menu = NULL;
+   dp->item = NULL;
+   dp->mtime = 0;
+   dp->fd = -1;
+   dp->buffer = NULL;
+   dp->next = dynamicMenus;
+   dynamicMenus = dp;
+   return dp;
+}
+
+/** Destroy a dynamic menu. */
+void DestroyDynamicMenu(DynamicMenu *dp)
+{
+   DynamicMenu **lp;
+   for(lp = &dynamicMenus; *lp; lp = &(*lp)->next) {
+      if(*lp == dp) {
+         *lp = dp->next;
+         break;
+      }
+   }
+   ReleaseDynamicMenuData(dp);
+   Release(dp->command);
+   if(dp->depends) {
+      Release(dp->depends);
+   }
+   Release(dp);
+}
+
+/** Stop the program and destroy the menu of a dynamic menu. */
+void ReleaseDynamicMenuData(DynamicMenu *dp)
+{
+   if(dp->fd >= 0) {
+      UnregisterDescriptor(dp->fd);
+      close(dp->fd);
+      dp->fd = -1;
+      Release(dp->buffer);
+      dp->buffer = NULL;
+   }
+   if(dp->item) {
+      dp->item->submenu = NULL;
+      dp->item = NULL;
+   }
+   if(dp->menu) {
+      Menu *menu = dp->menu;
+      dp->menu = NULL;
+      DestroyMenu(menu);
+   }
+}
+
+/** Prepare the submenu of a dynamic menu item. */
+void PrefetchDynamicMenu(MenuItem *item)
+{
+   DynamicMenu *dp = item->action.context;
+
+   /* Nothing to do if the item is already set up. */
+   if(dp->item) {
+      return;
+   }
+   dp->item = item;
+
+   if(IsDynamicMenuCurrent(dp)) {
+      item->submenu = dp->menu;
+      return;
+   }
+   if(dp->menu) {
+      DestroyMenu(dp->menu);
+      dp->menu = NULL;
+   }
+
+   /* Start the program unless it is still running from an earlier use. */
+   if(dp->fd < 0) {
+      StartDynamicMenu(dp);
+   }
+}
+
+/** Detach the submenu of a dynamic menu item. */
+void ReleaseDynamicMenu(MenuItem *item)
+{
+   DynamicMenu *dp = item->action.context;
+   item->submenu = NULL;
+   dp->item = NULL;
+   if(!dp->cached && dp->menu) {
+      DestroyMenu(dp->menu);
+      dp->menu = NULL;
+   }
+}
+
+/** Determine if the generated menu can still be used. */
+char IsDynamicMenuCurrent(const DynamicMenu *dp)
+{
+   if(!dp->menu) {
+      return 0;
+   }
+   if(dp->ttl) {
+      /* GetTimeDifference is limited to a minute; compare seconds. */
+      TimeType now;
+      GetCurrentTime(&now);
+      if(now.seconds < dp->loaded.seconds
+         || now.seconds - dp->loaded.seconds >= dp->ttl) {
+         return 0;
+      }
+   }
+   if(dp->depends && GetDependsTime(dp) != dp->mtime) {
+      return 0;
+   }
+   return 1;
+}
+
+/** Get the modification time of the file a dynamic menu depends on. */
+long GetDependsTime(const DynamicMenu *dp)
+{
+   struct stat sbuf;
+   if(stat(dp->depends, &sbuf) != 0) {
+      return 0;
+   }
+   return (long)sbuf.st_mtime;
+}
+
+/** Start generating a dynamic menu.
+ * Files are read directly. Programs run in a child process and their
+ * output is read as it becomes available. If the child cannot be
+ * started, the menu is generated directly.
+ */
+void StartDynamicMenu(DynamicMenu *dp)
+{
+   char *path;
+   int fds[2];
+   pid_t pid;
+
+   GetCurrentTime(&dp->loaded);
+   if(dp->depends) {
+      dp->mtime = GetDependsTime(dp);
+   }
+
+   if(strncmp(dp->command, "exec:", 5) || JUNLIKELY(pipe(fds) < 0)) {
+      SetDynamicMenu(dp, ParseDynamicMenu(dp->command));
+      return;
+   }
+
+   path = CopyString(&dp->command[5]);
+   ExpandPath(&path);
+   pid = fork();
+   if(pid == 0) {
+      close(ConnectionNumber(display));
+      close(fds[0]);
+      if(fds[1] != STDOUT_FILENO) {
+         dup2(fds[1], STDOUT_FILENO);
+         close(fds[1]);
+      }
+      execl(SHELL_NAME, SHELL_NAME, "-c", path, NULL);
+      _exit(EXIT_FAILURE);
+   }
+   Release(path);
+   close(fds[1]);
+   if(JUNLIKELY(pid < 0)) {
+      close(fds[0]);
+      SetDynamicMenu(dp, ParseDynamicMenu(dp->command));
+      return;
+   }
+
+   fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+   fcntl(fds[0], F_SETFL, O_NONBLOCK);
+   dp->fd = fds[0];
+   dp->size = DYNAMIC_BUFFER_SIZE;
+   dp->length = 0;
+   dp->buffer = Allocate(dp->size + 1);
+   RegisterDescriptor(dp->fd, HandleDynamicData, dp);
+}
+
+/** Read output from the program generating a dynamic menu. */
+void HandleDynamicData(int fd, void *data)
+{
+   DynamicMenu *dp = (DynamicMenu*)data;
+   for(;;) {
+      ssize_t rc;
+
+      if(dp->length == dp->size) {
+         dp->size *= 2;
+         dp->buffer = Reallocate(dp->buffer, dp->size + 1);
+      }
+
+      rc = read(fd, &dp->buffer[dp->length], dp->size - dp->length);
+      if(rc < 0 && errno == EINTR) {
+         continue;
+      } else if(rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+         return;
+      } else if(rc <= 0) {
+         if(JUNLIKELY(rc < 0)) {
+            Warning(_("could not read file: %s"), strerror(errno));
+         }
+         FinishDynamicMenu(dp);
+         return;
+      }
+      dp->length += rc;
+   }
+}
+
+/** Parse the output of a program once it is done. */
+void FinishDynamicMenu(DynamicMenu *dp)
+{
+   char *buffer = dp->buffer;
+
+   UnregisterDescriptor(dp->fd);
+   close(dp->fd);
+   dp->fd = -1;
+   dp->buffer = NULL;
+
+   /* Menus that are not kept are only needed while shown. */
+   if(dp->item || dp->cached) {
+      buffer[dp->length] = 0;
+      SetDynamicMenu(dp, ParseDynamicMenuOutput(dp->command, buffer));
+   }
+   Release(buffer);
+}
+
+/** Set the generated menu of a dynamic menu. */
+void SetDynamicMenu(DynamicMenu *dp, Menu *menu)
+{
+   if(JUNLIKELY(!menu)) {
+      return;
+   }
+   menu->itemHeight = dp->height;
+   InitializeMenu(menu);
+   dp->menu = menu;
+   if(dp->item) {
+      dp->item->submenu = menu;
+      OpenSelectedSubmenu(dp->item);
+   }
+}
@@ -0,0 +1,53 @@
+/**
+ * @file dynamic.h
+ *
+ * @brief Dynamic menus (generated by a file or program).
+ *
+ */
+
+#ifndef DYNAMIC_H
+#define DYNAMIC_H
+
+struct MenuItem;
+
+/** Opaque structure for a dynamic menu. */
+typedef struct DynamicMenu DynamicMenu;
+
+/*@{*/
+#define InitializeDynamicMenus() (void)(0)
+#define StartupDynamicMenus()    (void)(0)
+void ShutdownDynamicMenus(void);
+#define DestroyDynamicMenus()    (void)(0)
+/*@}*/
+
+/** Create a dynamic menu.
+ * @param command The file or program ("exec:") generating the menu.
+ * @param height The item height for the menu.
+ * @param ttl Seconds to keep the menu (0 for no time limit).
+ * @param depends A file that invalidates the menu when changed (or NULL).
+ * The menu is only kept between uses if ttl or depends is set.
+ * @return The dynamic menu.
+ */
+DynamicMenu *CreateDynamicMenu(const char *command, int height,
+                               unsigned ttl, const char *depends);
+
+/** Destroy a dynamic menu.
+ * @param dp The dynamic menu.
+ */
+void DestroyDynamicMenu(DynamicMenu *dp);
+
+/** Prepare the submenu of a dynamic menu item.
+ * This is called when the menu containing the item is shown.
+ * The submenu is attached to the item immediately if it is cached and
+ * otherwise once its program finishes.
+ * @param item The menu item (action.context is the dynamic menu).
+ */
+void PrefetchDynamicMenu(struct MenuItem *item);
+
+/** Detach the submenu of a dynamic menu item.
+ * This is called when the menu containing the item is hidden.
+ * @param item The menu item.
+ */
+void ReleaseDynamicMenu(struct MenuItem *item);
+
+#endif /* DYNAMIC_H */
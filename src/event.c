@@ -23,6 +23,7 @@
 #include "resize.h"
 #include "root.h"
 #include "swallow.h"
+#include "thumbnail.h"
 #include "taskbar.h"
 #include "timing.h"
 #include "winmenu.h"
@@ -31,9 +32,14 @@
 #include "popup.h"
 #include "pager.h"
 #include "grab.h"
+#include "misc.h"
+#include "border.h"
 
 #define MIN_TIME_DELTA 50
 
+/** Minimum time between pager updates (about one frame at 60 Hz). */
+#define MIN_PAGER_DELTA 16
+
 Time eventTime = CurrentTime;
 
 typedef struct CallbackNode {
@@ -46,11 +52,35 @@ typedef struct CallbackNode {
 
 static CallbackNode *callbacks = NULL;
 
+typedef struct TimeoutNode {
+   TimeType start;
+   int delay;
+   SignalCallback callback;
+   void *data;
+   struct TimeoutNode *next;
+} TimeoutNode;
+
+static TimeoutNode *timeouts = NULL;
+
+typedef struct DescriptorNode {
+   int fd;
+   DescriptorCallback callback;
+   void *data;
+   struct DescriptorNode *next;
+} DescriptorNode;
+
+static DescriptorNode *descriptors = NULL;
+
 static char restack_pending = 0;
 static char task_update_pending = 0;
+static TimeType last_pager_update = ZERO_TIME;
 static char pager_update_pending = 0;
+static char icon_update_pending = 0;
 
 static void Signal(void);
+static void SignalTimeouts(const TimeType *now);
+static long GetTimeoutDelay(long sleepTime);
+static void SignalDescriptors(fd_set *fds);
 static void DispatchBorderButtonEvent(const XButtonEvent *event,
                                       ClientNode *np);
 
@@ -92,9 +122,10 @@ char WaitForEvent(XEvent *event)
 {
    struct timeval timeout;
    CallbackNode *cp;
+   DescriptorNode *dp;
    fd_set fds;
    long sleepTime;
-   int fd;
+   int fd, maxfd;
    char handled;
 
 #ifdef ConnectionNumber
@@ -114,19 +145,35 @@ char WaitForEvent(XEvent *event)
    do {
 
       while(JXPending(display) == 0) {
+         FlushTrays();
          FD_ZERO(&fds);
          FD_SET(fd, &fds);
-         timeout.tv_sec = sleepTime / 1000;
-         timeout.tv_usec = (sleepTime % 1000) * 1000;
-         if(select(fd + 1, &fds, NULL, NULL, &timeout) <= 0) {
-            Signal();
+         maxfd = fd;
+         for(dp = descriptors; dp; dp = dp->next) {
+            FD_SET(dp->fd, &fds);
+            maxfd = Max(maxfd, dp->fd);
+         }
+         if(pager_update_pending) {
+            /* Wake up for a pager update that was deferred. */
+            timeout.tv_sec = 0;
+            timeout.tv_usec = MIN_PAGER_DELTA * 1000;
+         } else {
+            const long delay = GetTimeoutDelay(sleepTime);
+            timeout.tv_sec = delay / 1000;
+            timeout.tv_usec = (delay % 1000) * 1000;
          }
+         if(select(maxfd + 1, &fds, NULL, NULL, &timeout) > 0
+            && descriptors) {
+            SignalDescriptors(&fds);
+         }
+         Signal();
          if(JUNLIKELY(shouldExit)) {
             return 0;
          }
       }
 
       Signal();
+      FlushTrays();
 
       JXNextEvent(display, event);
       UpdateTime(event);
@@ -226,6 +273,9 @@ char WaitForEvent(XEvent *event)
       if(!handled) {
          handled = ProcessPopupEvent(event);
       }
+      if(!handled) {
+         handled = ProcessThumbnailEvent(event);
+      }
 
    } while(handled && JLIKELY(!shouldExit));
 
@@ -243,6 +293,13 @@ void Signal(void)
    Window w;
    int x, y;
 
+   if(icon_update_pending) {
+      ExposeCurrentDesktop();
+      RedrawTrays();
+      RedrawTaskBars();
+      task_update_pending = 1;
+      icon_update_pending = 0;
+   }
    if(restack_pending) {
       RestackClients();
       restack_pending = 0;
@@ -251,12 +308,20 @@ void Signal(void)
       UpdateTaskBar();
       task_update_pending = 0;
    }
-   if(pager_update_pending) {
+
+   /* Limit pager updates (for example while moving a window). */
+   GetCurrentTime(&now);
+   if(pager_update_pending
+      && GetTimeDifference(&now, &last_pager_update) >= MIN_PAGER_DELTA) {
       UpdatePager();
       pager_update_pending = 0;
+      last_pager_update = now;
+   }
+
+   if(timeouts) {
+      SignalTimeouts(&now);
    }
 
-   GetCurrentTime(&now);
    if(GetTimeDifference(&now, &last) < MIN_TIME_DELTA) {
       return;
    }
@@ -271,6 +336,63 @@ void Signal(void)
    }
 }
 
+/** Run timeouts that have expired. */
+void SignalTimeouts(const TimeType *now)
+{
+   TimeoutNode **tpp;
+   TimeoutNode *tp;
+   Window w;
+   int x, y;
+
+   /* The list is scanned from the start after each timeout, since
+    * the timeout function may register or cancel timeouts. */
+   for(;;) {
+      for(tpp = &timeouts; *tpp; tpp = &(*tpp)->next) {
+         if(GetTimeDifference(now, &(*tpp)->start) >= (*tpp)->delay) {
+            break;
+         }
+      }
+      tp = *tpp;
+      if(!tp) {
+         break;
+      }
+      *tpp = tp->next;
+      GetMousePosition(&x, &y, &w);
+      (tp->callback)(now, x, y, w, tp->data);
+      Release(tp);
+   }
+}
+
+/** Get how long to sleep before the next timeout expires. */
+long GetTimeoutDelay(long sleepTime)
+{
+   const TimeoutNode *tp;
+   TimeType now;
+   long elapsed;
+
+   if(timeouts) {
+      GetCurrentTime(&now);
+      for(tp = timeouts; tp; tp = tp->next) {
+         elapsed = GetTimeDifference(&now, &tp->start);
+         sleepTime = Min(sleepTime, Max(0, tp->delay - elapsed));
+      }
+   }
+   return sleepTime;
+}
+
+/** Run callbacks for file descriptors that are ready. */
+void SignalDescriptors(fd_set *fds)
+{
+   DescriptorNode *dp = descriptors;
+   while(dp) {
+      DescriptorNode *next = dp->next;
+      if(FD_ISSET(dp->fd, fds)) {
+         (dp->callback)(dp->fd, dp->data);
+      }
+      dp = next;
+   }
+}
+
 /** Process an event. */
 void ProcessEvent(XEvent *event)
 {
@@ -861,6 +983,7 @@ char HandlePropertyNotify(const XPropertyEvent *event)
             ReadWMProtocols(np->window, &np->state);
          } else if(event->atom == atoms[ATOM_NET_WM_ICON]) {
             LoadIcon(np);
+            InvalidateTaskBarClient(np);
             changed = 1;
          } else if(event->atom == atoms[ATOM_NET_WM_NAME]) {
             ReadWMName(np);
@@ -1768,6 +1891,61 @@ void UnregisterCallback(SignalCallback callback, void *data)
    Assert(0);
 }
 
+/** Register a function to run once after a delay. */
+void RegisterTimeout(int delay, SignalCallback callback, void *data)
+{
+   TimeoutNode *tp;
+   CancelTimeout(callback, data);
+   tp = Allocate(sizeof(TimeoutNode));
+   GetCurrentTime(&tp->start);
+   tp->delay = delay;
+   tp->callback = callback;
+   tp->data = data;
+   tp->next = timeouts;
+   timeouts = tp;
+}
+
+/** Cancel a timeout. */
+void CancelTimeout(SignalCallback callback, void *data)
+{
+   TimeoutNode **tpp;
+   for(tpp = &timeouts; *tpp; tpp = &(*tpp)->next) {
+      if((*tpp)->callback == callback && (*tpp)->data == data) {
+         TimeoutNode *temp = *tpp;
+         *tpp = temp->next;
+         Release(temp);
+         return;
+      }
+   }
+}
+
+/** Register a file descriptor to watch. */
+void RegisterDescriptor(int fd, DescriptorCallback callback, void *data)
+{
+   DescriptorNode *dp;
+   dp = Allocate(sizeof(DescriptorNode));
+   dp->fd = fd;
+   dp->callback = callback;
+   dp->data = data;
+   dp->next = descriptors;
+   descriptors = dp;
+}
+
+/** Unregister a file descriptor. */
+void UnregisterDescriptor(int fd)
+{
+   DescriptorNode **dp;
+   for(dp = &descriptors; *dp; dp = &(*dp)->next) {
+      if((*dp)->fd == fd) {
+         DescriptorNode *temp = *dp;
+         *dp = (*dp)->next;
+         Release(temp);
+         return;
+      }
+   }
+   Assert(0);
+}
+
 /** Restack clients before waiting for an event. */
 void RequireRestack()
 {
@@ -1785,3 +1963,9 @@ void RequirePagerUpdate()
 {
    pager_update_pending = 1;
 }
+
+/** Redraw everything showing icons before waiting for an event. */
+void RequireIconUpdate()
+{
+   icon_update_pending = 1;
+}
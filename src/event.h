@@ -17,6 +17,8 @@ typedef void (*SignalCallback)(const struct TimeType *now,
                                Window w,
                                void *data);
 
+typedef void (*DescriptorCallback)(int fd, void *data);
+
 /** Last event time. */
 extern Time eventTime;
 
@@ -63,6 +65,35 @@ void RegisterCallback(int freq, SignalCallback callback, void *data);
  */
 void UnregisterCallback(SignalCallback callback, void *data);
 
+/** Register a function to run once after a delay.
+ * A pending timeout for the same function and data is restarted.
+ * Timeouts may be registered and cancelled from a timeout function.
+ * @param delay The delay in milliseconds.
+ * @param callback The function to call.
+ * @param data Data to pass to the function.
+ */
+void RegisterTimeout(int delay, SignalCallback callback, void *data);
+
+/** Cancel a timeout.
+ * Nothing happens if the timeout is not pending.
+ * @param callback The function passed to RegisterTimeout.
+ * @param data The data passed to RegisterTimeout.
+ */
+void CancelTimeout(SignalCallback callback, void *data);
+
+/** Register a file descriptor to watch while waiting for events.
+ * @param fd The file descriptor.
+ * @param callback The function to call when fd is readable.
+ * @param data Data to pass to the callback.
+ */
+void RegisterDescriptor(int fd, DescriptorCallback callback, void *data);
+
+/** Unregister a file descriptor.
+ * This may be called from the callback for the descriptor.
+ * @param fd The file descriptor to remove.
+ */
+void UnregisterDescriptor(int fd);
+
 /** Restack clients before waiting for an event. */
 void RequireRestack();
 
@@ -72,5 +103,10 @@ void RequireTaskUpdate();
 /** Update the pager before waiting for an event. */
 void RequirePagerUpdate();
 
+/** Redraw everything showing icons before waiting for an event.
+ * This is used when icons finish loading in the background.
+ */
+void RequireIconUpdate();
+
 #endif /* EVENT_H */
 
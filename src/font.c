@@ -38,8 +38,42 @@ static const struct {
    { FONT_TRAY, FONT_TRAYBUTTON  }
 };
 
+/** Number of string widths to remember. */
+#define WIDTH_CACHE_SIZE   256
+
+/** Number of buckets in the string width hash (a power of 2). */
+#define WIDTH_HASH_SIZE    128
+
+/** Cached width of a string. */
+typedef struct WidthNode {
+   char *str;                    /**< The string (NULL if unused). */
+   unsigned hash;                /**< Hash of the font and string. */
+   FontType font;                /**< The font. */
+   int width;                    /**< Width of the string in pixels. */
+   struct WidthNode *hashNext;   /**< Next node in the hash bucket. */
+   struct WidthNode *prev;       /**< More recently used node. */
+   struct WidthNode *next;       /**< Less recently used node. */
+} WidthNode;
+
 static char *GetUTF8String(const char *str);
 static void ReleaseUTF8String(char *utf8String);
+static int MeasureString(FontType ft, const char *str);
+static int MeasureVisualString(FontType ft, const char *output, int len);
+static void RenderVisualString(Drawable d, FontType font, ColorType color,
+                               int x, int y, int width,
+                               const char *output, int len, int textWidth);
+static void DrawVisualString(Drawable d, FontType font, ColorType color,
+                             int x, int y, const char *output, int len);
+static void SetTextClip(Drawable d, FontType font, int x, int y,
+                        int width, int textWidth);
+static void SetClipRectangle(Drawable d, XRectangle *rect);
+#ifdef USE_XFT
+static const FT_UInt *GetPreparedGlyphs(FontType ft,
+                                        const PreparedText *text);
+static int DecodeUTF8(const unsigned char *str, int len, FcChar32 *ch);
+#endif
+static unsigned GetWidthHash(FontType ft, const char *str);
+static void ClearWidthCache(void);
 
 static char *fontNames[FONT_COUNT];
 
@@ -55,6 +89,29 @@ static XftFont *fonts[FONT_COUNT];
 static XFontStruct *fonts[FONT_COUNT];
 #endif
 
+/** Text drawing state.
+ * This is reused for consecutive strings on the same drawable.
+ */
+#ifdef USE_XFT
+static XftDraw *textDraw = NULL;
+#else
+static GC textGC = None;
+#endif
+static Drawable textDrawable = None;
+
+/** String width cache.
+ * The nodes are kept in a list ordered from most to least recently used.
+ */
+static WidthNode widthNodes[WIDTH_CACHE_SIZE];
+static WidthNode *widthHash[WIDTH_HASH_SIZE];
+static WidthNode *widthHead;
+static WidthNode *widthTail;
+
+/** Width of each ASCII character in each font (0 if not yet measured). */
+static int charWidths[FONT_COUNT][128];
+static unsigned long widthHits;
+static unsigned long widthMisses;
+
 /** Initialize font data. */
 void InitializeFonts(void)
 {
@@ -68,6 +125,19 @@ void InitializeFonts(void)
       fontNames[x] = NULL;
    }
 
+   /* Link all width nodes into the LRU list. */
+   memset(widthNodes, 0, sizeof(widthNodes));
+   memset(widthHash, 0, sizeof(widthHash));
+   for(x = 0; x < WIDTH_CACHE_SIZE; x++) {
+      widthNodes[x].prev = x > 0 ? &widthNodes[x - 1] : NULL;
+      widthNodes[x].next = x + 1 < WIDTH_CACHE_SIZE
+                         ? &widthNodes[x + 1] : NULL;
+   }
+   widthHead = &widthNodes[0];
+   widthTail = &widthNodes[WIDTH_CACHE_SIZE - 1];
+   widthHits = 0;
+   widthMisses = 0;
+
    /* Allocate a conversion descriptor if we're not using UTF-8. */
 #ifdef USE_ICONV
    codeset = nl_langinfo(CODESET);
@@ -142,6 +212,22 @@ void StartupFonts(void)
 void ShutdownFonts(void)
 {
    unsigned int x;
+   Debug("string width cache: %lu hits, %lu misses",
+         widthHits, widthMisses);
+   ClearWidthCache();
+   memset(charWidths, 0, sizeof(charWidths));
+#ifdef USE_XFT
+   if(textDraw) {
+      JXftDrawDestroy(textDraw);
+      textDraw = NULL;
+   }
+#else
+   if(textGC != None) {
+      JXFreeGC(display, textGC);
+      textGC = None;
+   }
+#endif
+   textDrawable = None;
    for(x = 0; x < FONT_COUNT; x++) {
       if(fonts[x]) {
 #ifdef USE_XFT
@@ -164,6 +250,7 @@ void DestroyFonts(void)
          fontNames[x] = NULL;
       }
    }
+   ClearWidthCache();
 #ifdef USE_ICONV
    if(fromUTF8 != (iconv_t)-1) {
       iconv_close(fromUTF8);
@@ -246,9 +333,107 @@ void ReleaseUTF8String(char *utf8String)
 /** Get the width of a string. */
 int GetStringWidth(FontType ft, const char *str)
 {
-#ifdef USE_XFT
-   XGlyphInfo extents;
-#endif
+   const unsigned hash = GetWidthHash(ft, str);
+   WidthNode **npp = &widthHash[hash & (WIDTH_HASH_SIZE - 1)];
+   WidthNode *np;
+
+   /* Look for a cached width. */
+   for(np = *npp; np; np = np->hashNext) {
+      if(np->hash == hash && np->font == ft && !strcmp(np->str, str)) {
+         widthHits += 1;
+         break;
+      }
+   }
+
+   if(!np) {
+
+      /* Reuse the least recently used node. */
+      widthMisses += 1;
+      np = widthTail;
+      if(np->str) {
+         WidthNode **old = &widthHash[np->hash & (WIDTH_HASH_SIZE - 1)];
+         while(*old != np) {
+            old = &(*old)->hashNext;
+         }
+         *old = np->hashNext;
+         Release(np->str);
+      }
+      np->str = CopyString(str);
+      np->hash = hash;
+      np->font = ft;
+      np->width = MeasureString(ft, str);
+      np->hashNext = *npp;
+      *npp = np;
+
+   }
+
+   /* Move the node to the front of the list. */
+   if(np != widthHead) {
+      np->prev->next = np->next;
+      if(np->next) {
+         np->next->prev = np->prev;
+      } else {
+         widthTail = np->prev;
+      }
+      np->prev = NULL;
+      np->next = widthHead;
+      widthHead->prev = np;
+      widthHead = np;
+   }
+
+   return np->width;
+}
+
+/** Get the position of each character in a string. */
+char GetCharacterOffsets(FontType ft, const char *str, int *offsets)
+{
+   char temp[2];
+   int offset = 0;
+   unsigned x;
+   for(x = 0; str[x]; x++) {
+      const unsigned char ch = (unsigned char)str[x];
+      if(ch < 0x20 || ch >= 0x7F) {
+         return 0;
+      }
+      if(charWidths[ft][ch] == 0) {
+         temp[0] = (char)ch;
+         temp[1] = 0;
+         charWidths[ft][ch] = MeasureVisualString(ft, temp, 1);
+      }
+      offsets[x] = offset;
+      offset += charWidths[ft][ch];
+   }
+   offsets[x] = offset;
+   return 1;
+}
+
+/** Get the hash of a string for the width cache. */
+unsigned GetWidthHash(FontType ft, const char *str)
+{
+   unsigned hash = 5381 + ft;
+   while(*str) {
+      hash = (hash << 5) + hash + (unsigned char)*str;
+      str += 1;
+   }
+   return hash;
+}
+
+/** Forget all cached string widths. */
+void ClearWidthCache(void)
+{
+   unsigned x;
+   for(x = 0; x < WIDTH_CACHE_SIZE; x++) {
+      if(widthNodes[x].str) {
+         Release(widthNodes[x].str);
+         widthNodes[x].str = NULL;
+      }
+   }
+   memset(widthHash, 0, sizeof(widthHash));
+}
+
+/** Measure the width of a string. */
+int MeasureString(FontType ft, const char *str)
+{
 #ifdef USE_FRIBIDI
    FriBidiChar *temp_i;
    FriBidiChar *temp_o;
@@ -282,13 +467,7 @@ int GetStringWidth(FontType ft, const char *str)
 #endif
 
    /* Get the width of the string. */
-#ifdef USE_XFT
-   JXftTextExtentsUtf8(display, fonts[ft], (const unsigned char*)output,
-                       len, &extents);
-   result = extents.xOff;
-#else
-   result = XTextWidth(fonts[ft], output, len);
-#endif
+   result = MeasureVisualString(ft, output, len);
 
    /* Clean up. */
 #ifdef USE_FRIBIDI
@@ -325,8 +504,6 @@ void SetFont(FontType type, const char *value)
 void RenderString(Drawable d, FontType font, ColorType color,
                   int x, int y, int width, const char *str)
 {
-   XRectangle rect;
-   Region renderRegion;
    int len;
    char *output;
 #ifdef USE_FRIBIDI
@@ -334,14 +511,6 @@ void RenderString(Drawable d, FontType font, ColorType color,
    FriBidiChar *temp_o;
    FriBidiParType type = FRIBIDI_PAR_ON;
    int unicodeLength;
-#endif
-#ifdef USE_XFT
-   XftDraw *xd;
-   XGlyphInfo extents;
-#else
-   XGCValues gcValues;
-   unsigned long gcMask;
-   GC gc;
 #endif
    char *utf8String;
 
@@ -356,15 +525,6 @@ void RenderString(Drawable d, FontType font, ColorType color,
    /* Get the length of the UTF-8 string. */
    len = strlen(utf8String);
 
-#ifdef USE_XFT
-   xd = XftDrawCreate(display, d, rootVisual, rootColormap);
-#else
-   gcMask = GCGraphicsExposures;
-   gcValues.graphics_exposures = False;
-   gc = JXCreateGC(display, d, gcMask, &gcValues);
-#endif
-
-
    /* Apply the bidi algorithm if requested. */
 #ifdef USE_FRIBIDI
    temp_i = AllocateStack((len + 1) * sizeof(FriBidiChar));
@@ -380,51 +540,276 @@ void RenderString(Drawable d, FontType font, ColorType color,
    output = utf8String;
 #endif
 
-   /* Get the bounds for the string based on the specified width. */
-   rect.x = x;
-   rect.y = y;
-   rect.height = GetStringHeight(font);
+   RenderVisualString(d, font, color, x, y, width, output, len,
+                      MeasureVisualString(font, output, len));
+
+   /* Free any memory used for UTF conversion. */
+#ifdef USE_FRIBIDI
+   ReleaseStack(temp_i);
+   ReleaseStack(temp_o);
+   ReleaseStack(output);
+#endif
+   ReleaseUTF8String(utf8String);
+
+}
+
+/** Measure a string that is already in visual order. */
+int MeasureVisualString(FontType ft, const char *output, int len)
+{
 #ifdef USE_XFT
-   JXftTextExtentsUtf8(display, fonts[font], (const unsigned char*)output,
+   XGlyphInfo extents;
+   JXftTextExtentsUtf8(display, fonts[ft], (const unsigned char*)output,
                        len, &extents);
-   rect.width = extents.xOff;
+   return extents.xOff;
 #else
-   rect.width = XTextWidth(fonts[font], output, len);
+   return XTextWidth(fonts[ft], output, len);
 #endif
-   rect.width = Min(rect.width, width) + 2;
+}
 
-   /* Combine the width bounds with the region to use. */
-   renderRegion = XCreateRegion();
-   XUnionRectWithRegion(&rect, renderRegion, renderRegion);
+/** Display a string that is already in visual order. */
+void RenderVisualString(Drawable d, FontType font, ColorType color,
+                        int x, int y, int width,
+                        const char *output, int len, int textWidth)
+{
+   SetTextClip(d, font, x, y, width, textWidth);
+   DrawVisualString(d, font, color, x, y, output, len);
+}
 
-   /* Display the string. */
+/** Display part of a string.
+ * Only printable ASCII is supported, so no conversion is needed.
+ */
+void RenderStringPart(Drawable d, FontType font, ColorType color,
+                      int x, int y, int clipx, int clipWidth,
+                      const char *str)
+{
+   XRectangle rect;
+   rect.x = clipx;
+   rect.y = y;
+   rect.width = clipWidth;
+   rect.height = GetStringHeight(font);
+   SetClipRectangle(d, &rect);
+   DrawVisualString(d, font, color, x, y, str, strlen(str));
+}
+
+/** Draw a string that is already in visual order.
+ * The clip rectangle must already be set.
+ */
+void DrawVisualString(Drawable d, FontType font, ColorType color,
+                      int x, int y, const char *output, int len)
+{
 #ifdef USE_XFT
-   JXftDrawSetClip(xd, renderRegion);
-   JXftDrawStringUtf8(xd, GetXftColor(color), fonts[font],
+   JXftDrawStringUtf8(textDraw, GetXftColor(color), fonts[font],
                       x, y + fonts[font]->ascent,
                       (const unsigned char*)output, len);
-   JXftDrawChange(xd, rootWindow);
 #else
-   JXSetForeground(display, gc, colors[color]);
-   JXSetRegion(display, gc, renderRegion);
-   JXSetFont(display, gc, fonts[font]->fid);
-   JXDrawString(display, d, gc, x, y + fonts[font]->ascent, output, len);
+   JXSetForeground(display, textGC, colors[color]);
+   JXSetFont(display, textGC, fonts[font]->fid);
+   JXDrawString(display, d, textGC, x, y + fonts[font]->ascent,
+                output, len);
 #endif
+}
 
-   /* Free any memory used for UTF conversion. */
+/** Set up the text drawing state for a drawable and clip rectangle. */
+void SetTextClip(Drawable d, FontType font, int x, int y,
+                 int width, int textWidth)
+{
+   XRectangle rect;
+
+   /* Get the bounds for the string based on the specified width. */
+   rect.x = x;
+   rect.y = y;
+   rect.height = GetStringHeight(font);
+   rect.width = Min(textWidth, width) + 2;
+   SetClipRectangle(d, &rect);
+}
+
+/** Set the drawable and clip rectangle used to draw text. */
+void SetClipRectangle(Drawable d, XRectangle *rect)
+{
+#ifdef USE_XFT
+   if(!textDraw) {
+      textDraw = JXftDrawCreate(display, d, rootVisual, rootColormap);
+   } else if(textDrawable != d) {
+      JXftDrawChange(textDraw, d);
+   }
+   JXftDrawSetClipRectangles(textDraw, 0, 0, rect, 1);
+#else
+   if(textGC == None) {
+      XGCValues gcValues;
+      gcValues.graphics_exposures = False;
+      textGC = JXCreateGC(display, rootWindow, GCGraphicsExposures,
+                          &gcValues);
+   }
+   JXSetClipRectangles(display, textGC, 0, 0, rect, 1, Unsorted);
+#endif
+   textDrawable = d;
+}
+
+/** Stop drawing text on a drawable. */
+void ReleaseTextDrawable(Drawable d)
+{
+#ifdef USE_XFT
+   if(textDraw && textDrawable == d) {
+      JXftDrawChange(textDraw, rootWindow);
+      textDrawable = rootWindow;
+   }
+#endif
+}
+
+/** Prepare a string for rendering. */
+void PrepareText(PreparedText *text, const char *str)
+{
+#ifdef USE_FRIBIDI
+   FriBidiChar *temp_i;
+   FriBidiChar *temp_o;
+   FriBidiParType type = FRIBIDI_PAR_ON;
+   int unicodeLength;
+#endif
+   char *utf8String;
+   unsigned x;
+   int len;
+
+   /* Convert to UTF-8 if necessary. */
+   utf8String = GetUTF8String(str);
+   len = strlen(utf8String);
+
+   /* Apply the bidi algorithm if requested. */
 #ifdef USE_FRIBIDI
+   temp_i = AllocateStack((len + 1) * sizeof(FriBidiChar));
+   temp_o = AllocateStack((len + 1) * sizeof(FriBidiChar));
+   unicodeLength = fribidi_charset_to_unicode(FRIBIDI_CHAR_SET_UTF8,
+                                              utf8String, len, temp_i);
+   fribidi_log2vis(temp_i, unicodeLength, &type, temp_o, NULL, NULL, NULL);
+   text->str = Allocate(4 * len + 1);
+   fribidi_unicode_to_charset(FRIBIDI_CHAR_SET_UTF8, temp_o, unicodeLength,
+                              text->str);
    ReleaseStack(temp_i);
    ReleaseStack(temp_o);
-   ReleaseStack(output);
+#else
+   text->str = Allocate(len + 1);
+   memcpy(text->str, utf8String, len + 1);
 #endif
+   text->length = strlen(text->str);
    ReleaseUTF8String(utf8String);
 
-   XDestroyRegion(renderRegion);
+   /* Widths and glyphs are looked up when first needed. */
+   for(x = 0; x < FONT_COUNT; x++) {
+      text->widths[x] = -1;
+#ifdef USE_XFT
+      text->glyphs[x] = NULL;
+#endif
+   }
+}
 
+/** Release a prepared string. */
+void ReleasePreparedText(PreparedText *text)
+{
+   if(text->str) {
 #ifdef USE_XFT
-   XftDrawDestroy(xd);
+      unsigned x;
+      for(x = 0; x < FONT_COUNT; x++) {
+         if(text->glyphs[x]) {
+            Release(text->glyphs[x]);
+            text->glyphs[x] = NULL;
+         }
+      }
+#endif
+      Release(text->str);
+      text->str = NULL;
+   }
+}
+
+/** Get the width of a prepared string. */
+int GetPreparedTextWidth(FontType ft, const PreparedText *text)
+{
+   if(text->widths[ft] < 0) {
+      /* Widths are a cache, so they are filled in even for const text. */
+      ((PreparedText*)text)->widths[ft]
+         = MeasureVisualString(ft, text->str, text->length);
+   }
+   return text->widths[ft];
+}
+
+/** Display a prepared string. */
+void RenderPreparedText(Drawable d, FontType font, ColorType color,
+                        int x, int y, int width,
+                        const PreparedText *text)
+{
+#ifdef USE_XFT
+   const FT_UInt *glyphs;
+   if(text->length > 0) {
+      glyphs = GetPreparedGlyphs(font, text);
+      SetTextClip(d, font, x, y, width, GetPreparedTextWidth(font, text));
+      JXftDrawGlyphs(textDraw, GetXftColor(color), fonts[font],
+                     x, y + fonts[font]->ascent, glyphs, text->glyphCount);
+   }
 #else
-   JXFreeGC(display, gc);
+   if(text->length > 0) {
+      RenderVisualString(d, font, color, x, y, width,
+                         text->str, text->length,
+                         GetPreparedTextWidth(font, text));
+   }
 #endif
+}
+
+#ifdef USE_XFT
+/** Get the glyphs of a prepared string in a font. */
+const FT_UInt *GetPreparedGlyphs(FontType ft, const PreparedText *text)
+{
+   if(!text->glyphs[ft]) {
+      /* Glyphs are a cache, so they are filled in even for const text. */
+      PreparedText *tp = (PreparedText*)text;
+      const unsigned char *ptr = (const unsigned char*)text->str;
+      int left = text->length;
+      int count = 0;
+      tp->glyphs[ft] = Allocate(sizeof(FT_UInt) * (text->length + 1));
+      while(left > 0) {
+         FcChar32 ch;
+         const int used = DecodeUTF8(ptr, left, &ch);
+         if(used <= 0) {
+            break;
+         }
+         tp->glyphs[ft][count] = JXftCharIndex(display, fonts[ft], ch);
+         count += 1;
+         ptr += used;
+         left -= used;
+      }
+      tp->glyphCount = count;
+   }
+   return text->glyphs[ft];
+}
 
+/** Decode one character from a UTF-8 string.
+ * @return The number of bytes used (0 if the string is invalid).
+ */
+int DecodeUTF8(const unsigned char *str, int len, FcChar32 *ch)
+{
+   int count;
+   int x;
+   if(str[0] < 0x80) {
+      *ch = str[0];
+      return 1;
+   } else if((str[0] & 0xE0) == 0xC0) {
+      *ch = str[0] & 0x1F;
+      count = 2;
+   } else if((str[0] & 0xF0) == 0xE0) {
+      *ch = str[0] & 0x0F;
+      count = 3;
+   } else if((str[0] & 0xF8) == 0xF0) {
+      *ch = str[0] & 0x07;
+      count = 4;
+   } else {
+      return 0;
+   }
+   if(count > len) {
+      return 0;
+   }
+   for(x = 1; x < count; x++) {
+      if((str[x] & 0xC0) != 0x80) {
+         return 0;
+      }
+      *ch = (*ch << 6) | (str[x] & 0x3F);
+   }
+   return count;
 }
+#endif
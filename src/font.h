@@ -24,6 +24,21 @@ typedef unsigned char FontType;
 #define FONT_TRAYBUTTON 7
 #define FONT_COUNT      8
 
+/** Text prepared for rendering.
+ * This holds a string after character set conversion and bidi
+ * reordering so that it can be measured and drawn repeatedly without
+ * redoing that work. Widths remain valid until the fonts are reloaded.
+ */
+typedef struct PreparedText {
+   char *str;                 /**< UTF-8 string in visual order. */
+   int length;                /**< Length of str in bytes. */
+   int widths[FONT_COUNT];    /**< Width in each font (-1 if unknown). */
+#ifdef USE_XFT
+   FT_UInt *glyphs[FONT_COUNT];  /**< Glyphs in each font (or NULL). */
+   int glyphCount;               /**< Number of glyphs. */
+#endif
+} PreparedText;
+
 void InitializeFonts(void);
 void StartupFonts(void);
 void ShutdownFonts(void);
@@ -47,6 +62,33 @@ void SetFont(FontType type, const char *value);
 void RenderString(Drawable d, FontType font, ColorType color,
                   int x, int y, int width, const char *str);
 
+/** Render part of a string.
+ * The string is drawn at (x, y), but only the columns from clipx up to
+ * clipx + clipWidth are changed. The string must be printable ASCII.
+ * @param d The drawable on which to render the string.
+ * @param font The font to use.
+ * @param color The text color to use.
+ * @param x The x-coordinate at which to render.
+ * @param y The y-coordinate at which to render.
+ * @param clipx The first column to change.
+ * @param clipWidth The number of columns to change.
+ * @param str The string to render.
+ */
+void RenderStringPart(Drawable d, FontType font, ColorType color,
+                      int x, int y, int clipx, int clipWidth,
+                      const char *str);
+
+/** Get the position of each character in a string.
+ * Positions come from a per-font table of character widths, so this
+ * is cheaper than measuring the string. Only printable ASCII is supported.
+ * @param ft The font.
+ * @param str The string.
+ * @param offsets Filled with the x-offset of each character followed by
+ * the width of the string (strlen(str) + 1 entries).
+ * @return 1 on success, 0 if the string contains other characters.
+ */
+char GetCharacterOffsets(FontType ft, const char *str, int *offsets);
+
 /** Get the width of a string.
  * @param ft The font used to determine the width.
  * @param str The string whose width to get.
@@ -60,6 +102,44 @@ int GetStringWidth(FontType ft, const char *str);
  */
 int GetStringHeight(FontType ft);
 
+/** Prepare a string for rendering.
+ * @param text The prepared text to fill in.
+ * @param str The string to prepare.
+ */
+void PrepareText(PreparedText *text, const char *str);
+
+/** Release a prepared string.
+ * @param text The prepared text to release (str may be NULL).
+ */
+void ReleasePreparedText(PreparedText *text);
+
+/** Get the width of a prepared string.
+ * @param ft The font used to determine the width.
+ * @param text The prepared text.
+ * @return The width of the string in pixels.
+ */
+int GetPreparedTextWidth(FontType ft, const PreparedText *text);
+
+/** Render a prepared string.
+ * @param d The drawable on which to render the string.
+ * @param font The font to use.
+ * @param color The text color to use.
+ * @param x The x-coordinate at which to render.
+ * @param y The y-coordinate at which to render.
+ * @param width The maximum width allowed.
+ * @param text The prepared text.
+ */
+void RenderPreparedText(Drawable d, FontType font, ColorType color,
+                        int x, int y, int width,
+                        const PreparedText *text);
+
+/** Stop drawing text on a drawable.
+ * Text drawing state is kept for the last drawable used. This must be
+ * called before destroying a window on which text was drawn.
+ * @param d The drawable.
+ */
+void ReleaseTextDrawable(Drawable d);
+
 /** Convert a string from UTF-8.
  * Note that the string passed into this function is freed via Release
  * if the same string is not returned from the function.
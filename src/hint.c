@@ -724,6 +724,7 @@ void ReadWMName(ClientNode *np)
    if(np->name) {
       Release(np->name);
    }
+   ReleasePreparedText(&np->title);
 
    status = JXGetWindowProperty(display, np->window,
                                 atoms[ATOM_NET_WM_NAME], 0, 1024, False,
@@ -776,6 +777,11 @@ void ReadWMName(ClientNode *np)
       }
    }
 
+   /* Prepare the name for the title bar and task list. */
+   if(np->name) {
+      PrepareText(&np->title, np->name);
+   }
+
 }
 
 /** Read the window class for a client. */
@@ -18,6 +18,12 @@
 #include "color.h"
 #include "settings.h"
 #include "border.h"
+#include "upload.h"
+#include "event.h"
+#include "error.h"
+
+#include <errno.h>
+#include <fcntl.h>
 
 IconNode emptyIcon;
 
@@ -32,6 +38,12 @@ typedef struct IconPathNode {
    struct IconPathNode *next;
 } IconPathNode;
 
+/** Names for which a lookup in the icon paths failed. */
+typedef struct MissingIconNode {
+   char *name;
+   struct MissingIconNode *next;
+} MissingIconNode;
+
 /* These extensions are appended to icon names during search. */
 const char *ICON_EXTENSIONS[] = {
    "",
@@ -61,7 +73,76 @@ const char *ICON_EXTENSIONS[] = {
 static const unsigned EXTENSION_COUNT = ARRAY_LENGTH(ICON_EXTENSIONS);
 static const unsigned MAX_EXTENSION_LENGTH = 5;
 
+/** Most names remembered as missing before the list is cleared. */
+#define MAX_MISSING_ICONS 1024
+
+/** Maximum number of worker processes used to preload icons. */
+#define MAX_PRELOAD_WORKERS 4
+
+/** Largest icon (in pixels) decoded by a preload worker.
+ * Larger images are left to the main process.
+ */
+#define MAX_PRELOAD_PIXELS (256 * 256)
+
+/** Longest file name accepted from a preload worker. */
+#define MAX_PRELOAD_PATH 4096
+
+/** Initial size of the buffer for data from a preload worker. */
+#define PRELOAD_BUFFER_SIZE 4096
+
+/** Preload states. */
+typedef unsigned char PreloadStateType;
+#define PRELOAD_PENDING    0  /**< Waiting for the worker. */
+#define PRELOAD_READY      1  /**< Found and decoded. */
+#define PRELOAD_MISSING    2  /**< Not found in any icon path. */
+#define PRELOAD_DEFERRED   3  /**< Must be loaded by the main process. */
+#define PRELOAD_USED       4  /**< Result has been consumed. */
+
+/** An icon referenced by the configuration that is loaded at startup. */
+typedef struct PreloadNode {
+   char *name;                /**< The name of the icon. */
+   char *path;                /**< The file name, if ready. */
+   ImageNode *image;          /**< The decoded image, if ready. */
+   IconNode *icon;            /**< Icon waiting for the image (or NULL). */
+   unsigned worker;           /**< Index of the worker loading this icon. */
+   PreloadStateType state;    /**< The state of this entry. */
+   struct PreloadNode *next;  /**< Next entry in the hash chain. */
+} PreloadNode;
+
+/** Record written by a preload worker for each icon.
+ * For ready icons, the file name and the image data follow.
+ */
+typedef struct PreloadRecord {
+   unsigned index;
+   int width;
+   int height;
+   unsigned pathLength;
+   unsigned dataLength;
+   PreloadStateType state;
+   char bitmap;
+   char render;
+} PreloadRecord;
+
+/** Data received from a preload worker. */
+typedef struct PreloadWorker {
+   int fd;                    /**< Pipe from the worker (-1 if done). */
+   char *buffer;              /**< Data not yet processed. */
+   size_t length;             /**< Bytes in the buffer. */
+   size_t size;               /**< Size of the buffer. */
+} PreloadWorker;
+
 static IconNode **iconHash;
+static MissingIconNode *missingHash[HASH_SIZE];
+static unsigned missingCount;
+static PreloadNode *preloadHash[HASH_SIZE];
+static PreloadNode **preloadNodes;
+static unsigned preloadCount;
+static PreloadWorker preloadWorkers[MAX_PRELOAD_WORKERS];
+static unsigned preloadWorkerCount;
+static char preloadStarted;
+static unsigned iconSerial;
+static char preloadDeferred;
+static char isPreloadWorker;
 static IconPathNode *iconPaths;
 static IconPathNode *iconPathsTail;
 static GC iconGC;
@@ -75,15 +156,39 @@ static IconNode *CreateIcon(const ImageNode *image);
 static IconNode *CreateIconFromDrawable(Drawable d, Pixmap mask);
 static IconNode *CreateIconFromBinary(const unsigned long *data,
                                       unsigned int length);
+static IconNode *SearchNamedIcon(const char *name, char save,
+                                 char preserveAspect);
 static IconNode *LoadNamedIconHelper(const char *name, const char *path,
                                      char save, char preserveAspect);
+static ImageNode *LoadNamedImage(const char *name, const char *path,
+                                 char **fileName);
+static ImageNode *LoadIconImage(const char *fileName);
+static char IsScalableImage(const char *fileName);
+
+static void StartPreloadWorkers(void);
+static void RunPreloadWorker(int fd, unsigned first);
+static char WriteAll(int fd, const void *buffer, size_t length);
+static size_t GetPreloadDataLength(int width, int height, char bitmap);
+static void HandlePreloadData(int fd, void *data);
+static char ProcessPreloadRecords(PreloadWorker *wp);
+static void StorePreloadResult(const PreloadRecord *record,
+                               const char *payload);
+static void AbandonPreloadWorker(unsigned worker);
+static void StopPreloadWorkers(void);
+static PreloadNode *FindPreloadNode(const char *name);
+static void UsePreloadedImage(PreloadNode *pp, IconNode *icon);
+static void FinishPendingIcon(IconNode *icon);
 
 static ImageNode *GetBestImage(IconNode *icon, int rwidth, int rheight);
+static ImageNode *DecodeIconImage(IconNode *icon, int rwidth, int rheight);
 static ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
                                      int rwidth, int rheight);
 
 static void InsertIcon(IconNode *icon);
 static IconNode *FindIcon(const char *name);
+static void InsertMissingIcon(const char *name);
+static char IsMissingIcon(const char *name);
+static void ClearMissingIcons(void);
 static unsigned int GetHash(const char *str);
 
 /** Initialize icon data.
@@ -97,7 +202,16 @@ void InitializeIcons(void)
    iconHash = Allocate(sizeof(IconNode*) * HASH_SIZE);
    for(x = 0; x < HASH_SIZE; x++) {
       iconHash[x] = NULL;
+      missingHash[x] = NULL;
+      preloadHash[x] = NULL;
    }
+   missingCount = 0;
+   preloadNodes = NULL;
+   preloadCount = 0;
+   preloadWorkerCount = 0;
+   preloadStarted = 0;
+   isPreloadWorker = 0;
+   iconSerial = 0;
    memset(&emptyIcon, 0, sizeof(emptyIcon));
    iconSizeSet = 0;
    defaultIconName = NULL;
@@ -120,12 +234,15 @@ void StartupIcons(void)
    iconSize.width_inc = 1;
    iconSize.height_inc = 1;
    JXSetIconSizes(display, rootWindow, &iconSize, 1);
+
+   StartPreloadWorkers();
 }
 
 /** Shutdown icon support. */
 void ShutdownIcons(void)
 {
    unsigned int x;
+   StopPreloadWorkers();
    for(x = 0; x < HASH_SIZE; x++) {
       while(iconHash[x]) {
          DoDestroyIcon(x, iconHash[x]);
@@ -145,6 +262,22 @@ void DestroyIcons(void)
       iconPaths = pn;
    }
    iconPathsTail = NULL;
+   ClearMissingIcons();
+   if(preloadNodes) {
+      unsigned int x;
+      for(x = 0; x < preloadCount; x++) {
+         Release(preloadNodes[x]->name);
+         if(preloadNodes[x]->path) {
+            Release(preloadNodes[x]->path);
+         }
+         DestroyImage(preloadNodes[x]->image);
+         Release(preloadNodes[x]);
+      }
+      Release(preloadNodes);
+      preloadNodes = NULL;
+   }
+   preloadCount = 0;
+   memset(preloadHash, 0, sizeof(preloadHash));
    if(iconHash) {
       Release(iconHash);
       iconHash = NULL;
@@ -186,6 +319,9 @@ void AddIconPath(char *path)
    ExpandPath(&ip->path);
    ip->next = NULL;
 
+   /* Names that were not found before may be in the new path. */
+   ClearMissingIcons();
+
    if(iconPathsTail) {
       iconPathsTail->next = ip;
    } else {
@@ -247,6 +383,19 @@ void PutIcon(IconNode *icon, Drawable d, long fg,
 
 }
 
+/** Render an image at its natural size. */
+void PutImage(ImageNode *image, Drawable d, int x, int y)
+{
+   IconNode *icon = CreateIcon(image);
+   icon->images = image;
+   icon->preserveAspect = 0;
+   PutIcon(icon, d, 0, x, y, image->width, image->height);
+
+   /* The image belongs to the caller. */
+   icon->images = NULL;
+   DestroyIcon(icon);
+}
+
 /** Load the icon for a client. */
 void LoadIcon(ClientNode *np)
 {
@@ -292,7 +441,7 @@ IconNode *LoadNamedIcon(const char *name, char save, char preserveAspect)
 {
 
    IconNode *icon;
-   IconPathNode *ip;
+   PreloadNode *pp;
 
    Assert(name);
 
@@ -307,12 +456,56 @@ IconNode *LoadNamedIcon(const char *name, char save, char preserveAspect)
       return icon;
    }
 
+   /* Don't search the disk again for icons we already failed to find. */
+   if(IsMissingIcon(name)) {
+      return name[0] == '/' ? &emptyIcon : NULL;
+   }
+
+   /* Use the result from a preload worker if available.
+    * Preloaded images are only used for shared icons since transient
+    * icons are managed by their users. */
+   pp = save ? FindPreloadNode(name) : NULL;
+   if(pp && pp->state == PRELOAD_MISSING) {
+      pp->state = PRELOAD_USED;
+      InsertMissingIcon(name);
+      return name[0] == '/' ? &emptyIcon : NULL;
+   } else if(pp && pp->state == PRELOAD_READY) {
+      icon = CreateIcon(pp->image);
+      icon->preserveAspect = preserveAspect;
+      icon->scalable = IsScalableImage(pp->path);
+      icon->name = CopyString(pp->path);
+      if(name[0] != '/') {
+         icon->request = CopyString(name);
+      }
+      UsePreloadedImage(pp, icon);
+      InsertIcon(icon);
+      return icon;
+   }
+
+   /* Locate the icon; this only reads the size of the image. */
+   icon = SearchNamedIcon(name, save, preserveAspect);
+   if(pp && pp->state == PRELOAD_PENDING && icon && icon != &emptyIcon
+      && preloadWorkers[pp->worker].fd >= 0) {
+      /* Nothing is drawn until the worker sends the image. */
+      icon->pending = 1;
+      pp->icon = icon;
+   }
+   return icon;
+}
+
+/** Search for an icon file. */
+IconNode *SearchNamedIcon(const char *name, char save, char preserveAspect)
+{
+   IconNode *icon;
+   IconPathNode *ip;
+
    /* Check for an absolute file name. */
    if(name[0] == '/') {
-      ImageNode *image = LoadImage(name, 0, 0, 1);
+      ImageNode *image = LoadIconImage(name);
       if(image) {
          icon = CreateIcon(image);
          icon->preserveAspect = preserveAspect;
+         icon->scalable = IsScalableImage(name);
          icon->name = CopyString(name);
          if(save) {
             InsertIcon(icon);
@@ -320,6 +513,7 @@ IconNode *LoadNamedIcon(const char *name, char save, char preserveAspect)
          DestroyImage(image);
          return icon;
       } else {
+         InsertMissingIcon(name);
          return &emptyIcon;
       }
    }
@@ -333,12 +527,41 @@ IconNode *LoadNamedIcon(const char *name, char save, char preserveAspect)
    }
 
    /* The default icon. */
+   InsertMissingIcon(name);
    return NULL;
 }
 
 /** Helper for loading icons by name. */
 IconNode *LoadNamedIconHelper(const char *name, const char *path,
                               char save, char preserveAspect)
+{
+   ImageNode *image;
+   char *fileName;
+
+   /* Create the icon if we were able to load the image. */
+   image = LoadNamedImage(name, path, &fileName);
+   if(image) {
+      IconNode *result = CreateIcon(image);
+      result->preserveAspect = preserveAspect;
+      result->scalable = IsScalableImage(fileName);
+      result->name = fileName;
+      result->request = CopyString(name);
+      if(save) {
+         InsertIcon(result);
+      }
+      DestroyImage(image);
+      return result;
+   }
+
+   return NULL;
+}
+
+/** Load the image for an icon name from an icon path.
+ * On success, the file name is returned in fileName and must be released
+ * by the caller.
+ */
+ImageNode *LoadNamedImage(const char *name, const char *path,
+                          char **fileName)
 {
    ImageNode *image;
    char *temp;
@@ -371,32 +594,58 @@ IconNode *LoadNamedIconHelper(const char *name, const char *path,
    /* Attempt to load the image. */
    image = NULL;
    if(hasExtension) {
-      image = LoadImage(temp, 0, 0, 1);
+      image = LoadIconImage(temp);
    } else {
       for(i = 0; i < EXTENSION_COUNT; i++) {
          const unsigned len = strlen(ICON_EXTENSIONS[i]);
          memcpy(&temp[pathLength + nameLength], ICON_EXTENSIONS[i], len + 1);
-         image = LoadImage(temp, 0, 0, 1);
-         if(image) {
+         image = LoadIconImage(temp);
+         if(image || preloadDeferred) {
             break;
          }
       }
    }
+
+   *fileName = image ? CopyString(temp) : NULL;
    ReleaseStack(temp);
+   return image;
+}
 
-   /* Create the icon if we were able to load the image. */
-   if(image) {
-      IconNode *result = CreateIcon(image);
-      result->preserveAspect = preserveAspect;
-      result->name = CopyString(temp);
-      if(save) {
-         InsertIcon(result);
+/** Load the size of an image for an icon from a file.
+ * Only the header is read. Preload workers decode the image separately
+ * in RunPreloadWorker; without that, reading only the size would leave
+ * them nothing to do in parallel.
+ */
+ImageNode *LoadIconImage(const char *fileName)
+{
+   /* Skip files that could not be decoded; see DecodeIconImage. */
+   if(JUNLIKELY(IsMissingIcon(fileName))) {
+      return NULL;
+   }
+#ifdef USE_XPM
+   /* XPM images require the X connection, which preload workers
+    * don't have. Leave such icons to the main process. */
+   if(JUNLIKELY(isPreloadWorker)) {
+      const unsigned len = strlen(fileName);
+      if(len >= 4 && !StrCmpNoCase(&fileName[len - 4], ".xpm")
+         && access(fileName, R_OK) == 0) {
+         preloadDeferred = 1;
+         return NULL;
       }
-      DestroyImage(image);
-      return result;
    }
+#endif
+   return LoadImageInfo(fileName);
+}
 
-   return NULL;
+/** Determine if an image file can be rendered at any size. */
+char IsScalableImage(const char *fileName)
+{
+#if defined(USE_CAIRO) && defined(USE_RSVG)
+   const unsigned len = strlen(fileName);
+   return len >= 4 && !StrCmpNoCase(&fileName[len - 4], ".svg");
+#else
+   return 0;
+#endif
 }
 
 /** Read the icon property from a client. */
@@ -525,9 +774,25 @@ ImageNode *GetBestImage(IconNode *icon, int rwidth, int rheight)
    ImageNode *best;
    ImageNode *ip;
 
-   /* If we don't have an image loaded, load one. */
+   /* Draw nothing while a preload worker is decoding the image. */
+   if(icon->pending) {
+      return NULL;
+   }
+
+   /* Scalable images are rendered again to grow beyond the size
+    * decoded by the preload worker. */
+   if(icon->preloaded && icon->scalable
+      && (rwidth > icon->images->width || rheight > icon->images->height)) {
+      DestroyImage(icon->images);
+      icon->images = NULL;
+      icon->preloaded = 0;
+   }
+
+   /* If we don't have an image loaded, load one.
+    * The requested size already has the aspect ratio applied, so
+    * scalable images are rendered at exactly that size. */
    if(icon->images == NULL) {
-      return LoadImage(icon->name, rwidth, rheight, icon->preserveAspect);
+      return DecodeIconImage(icon, rwidth, rheight);
    }
 
    /* Find the best image to use.
@@ -567,6 +832,48 @@ ImageNode *GetBestImage(IconNode *icon, int rwidth, int rheight)
    return best;
 }
 
+/** Decode the image for an icon.
+ * The icon was located by reading only the image header, so the file
+ * may still fail to decode. In that case the file is treated as
+ * missing and the icon paths are searched again, as if the file had
+ * not been found in the first place.
+ */
+ImageNode *DecodeIconImage(IconNode *icon, int rwidth, int rheight)
+{
+   ImageNode *image;
+   IconPathNode *ip;
+
+   if(!IsMissingIcon(icon->name)) {
+      image = LoadImage(icon->name, rwidth, rheight,
+                        icon->scalable ? 0 : icon->preserveAspect);
+      if(image) {
+         return image;
+      }
+      InsertMissingIcon(icon->name);
+   }
+
+   if(!icon->request) {
+      return NULL;
+   }
+   for(ip = iconPaths; ip; ip = ip->next) {
+      char *fileName;
+      ImageNode *info = LoadNamedImage(icon->request, ip->path, &fileName);
+      if(info) {
+         const char preserveAspect = IsScalableImage(fileName)
+                                   ? 0 : icon->preserveAspect;
+         DestroyImage(info);
+         image = LoadImage(fileName, rwidth, rheight, preserveAspect);
+         if(image) {
+            Release(fileName);
+            return image;
+         }
+         InsertMissingIcon(fileName);
+         Release(fileName);
+      }
+   }
+   return NULL;
+}
+
 /** Get a scaled icon. */
 ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
                               int rwidth, int rheight)
@@ -609,8 +916,9 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
       if(!icon->bitmap || np->fg == fg) {
 #ifdef USE_XRENDER
          /* If we are using xrender and only have one image size
-          * available, we can simply scale the existing icon. */
-         if(icon->render) {
+          * available, we can simply scale the existing icon.
+          * Scalable images are rendered for each size instead. */
+         if(icon->render && !icon->scalable) {
             if(icon->images == NULL || icon->images->next == NULL) {
                return np;
             }
@@ -636,7 +944,9 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
       icon->nodes = np;
 
       /* Don't keep the image data around after creating the icon. */
-      if(icon->images == NULL) {
+      if(icon->images == NULL || icon->preloaded) {
+         icon->images = NULL;
+         icon->preloaded = 0;
          DestroyImage(imageNode);
       }
 
@@ -660,9 +970,7 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
    JXSetForeground(display, maskGC, 1);
 
    /* Create a temporary XImage for scaling. */
-   image = JXCreateImage(display, rootVisual, rootDepth,
-                         ZPixmap, 0, NULL, nwidth, nheight, 8, 0);
-   image->data = Allocate(sizeof(unsigned long) * nwidth * nheight);
+   image = CreateUploadImage(rootDepth, nwidth, nheight);
 
    /* Determine the scale factor. */
    scalex = (imageNode->width << 16) / nwidth;
@@ -723,13 +1031,14 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
                               rootDepth);
 
    /* Render the image to the color data pixmap. */
-   JXPutImage(display, np->image, rootGC, image, 0, 0, 0, 0, nwidth, nheight);   
+   PutUploadImage(np->image, rootGC, image);
+
    /* Release the XImage. */
-   Release(image->data);
-   image->data = NULL;
-   JXDestroyImage(image);
+   DestroyUploadImage(image);
 
-   if(icon->images == NULL) {
+   if(icon->images == NULL || icon->preloaded) {
+      icon->images = NULL;
+      icon->preloaded = 0;
       DestroyImage(imageNode);
    }
 
@@ -797,6 +1106,7 @@ IconNode *CreateIcon(const ImageNode *image)
    icon = Allocate(sizeof(IconNode));
    icon->nodes = NULL;
    icon->name = NULL;
+   icon->request = NULL;
    icon->images = NULL;
    icon->next = NULL;
    icon->prev = NULL;
@@ -807,7 +1117,10 @@ IconNode *CreateIcon(const ImageNode *image)
    icon->render = image->render;
 #endif
    icon->preserveAspect = 1;
+   icon->scalable = 0;
    icon->transient = 1;
+   icon->pending = 0;
+   icon->preloaded = 0;
    return icon;
 }
 
@@ -843,14 +1156,20 @@ void DoDestroyIcon(int index, IconNode *icon)
       if(icon->name) {
          Release(icon->name);
       }
-
-      if(icon->prev) {
-         icon->prev->next = icon->next;
-      } else {
-         iconHash[index] = icon->next;
+      if(icon->request) {
+         Release(icon->request);
       }
-      if(icon->next) {
-         icon->next->prev = icon->prev;
+
+      /* Transient icons are not in the hash. */
+      if(!icon->transient) {
+         if(icon->prev) {
+            icon->prev->next = icon->next;
+         } else {
+            iconHash[index] = icon->next;
+         }
+         if(icon->next) {
+            icon->next->prev = icon->prev;
+         }
       }
       Release(icon);
    }
@@ -896,6 +1215,443 @@ IconNode *FindIcon(const char *name)
    return NULL;
 }
 
+/** Request that an icon be loaded in the background during startup.
+ * Icons requested after the workers have started (for example, from a
+ * dynamic menu) are loaded when they are drawn.
+ */
+void PreloadIcon(const char *name)
+{
+   PreloadNode *pp;
+   unsigned int index;
+
+   if(!name || name[0] == 0 || preloadStarted) {
+      return;
+   }
+
+   index = GetHash(name);
+   for(pp = preloadHash[index]; pp; pp = pp->next) {
+      if(!strcmp(pp->name, name)) {
+         return;
+      }
+   }
+
+   pp = Allocate(sizeof(PreloadNode));
+   memset(pp, 0, sizeof(PreloadNode));
+   pp->name = CopyString(name);
+   pp->state = PRELOAD_PENDING;
+   pp->next = preloadHash[index];
+   preloadHash[index] = pp;
+
+   if(preloadCount == 0) {
+      preloadNodes = Allocate(16 * sizeof(PreloadNode*));
+   } else if((preloadCount % 16) == 0) {
+      preloadNodes = Reallocate(preloadNodes,
+                                (preloadCount + 16) * sizeof(PreloadNode*));
+   }
+   preloadNodes[preloadCount] = pp;
+   preloadCount += 1;
+}
+
+/** Start worker processes to locate and decode preloaded icons.
+ * Workers send the file name and the decoded image of each icon. The
+ * results are read as they arrive; see HandlePreloadData.
+ */
+void StartPreloadWorkers(void)
+{
+   unsigned x;
+
+   preloadStarted = 1;
+   preloadWorkerCount = Min(preloadCount, MAX_PRELOAD_WORKERS);
+   for(x = 0; x < preloadCount; x++) {
+      preloadNodes[x]->worker = x % preloadWorkerCount;
+   }
+
+   for(x = 0; x < preloadWorkerCount; x++) {
+      PreloadWorker *wp = &preloadWorkers[x];
+      int fds[2];
+      pid_t pid;
+
+      wp->fd = -1;
+      wp->buffer = NULL;
+      if(JUNLIKELY(pipe(fds) < 0)) {
+         AbandonPreloadWorker(x);
+         continue;
+      }
+      pid = fork();
+      if(pid == 0) {
+         unsigned i;
+         close(ConnectionNumber(display));
+         close(fds[0]);
+         for(i = 0; i < x; i++) {
+            if(preloadWorkers[i].fd >= 0) {
+               close(preloadWorkers[i].fd);
+            }
+         }
+         isPreloadWorker = 1;
+         RunPreloadWorker(fds[1], x);
+         _exit(EXIT_SUCCESS);
+      }
+      close(fds[1]);
+      if(JUNLIKELY(pid < 0)) {
+         close(fds[0]);
+         AbandonPreloadWorker(x);
+         continue;
+      }
+      fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+      fcntl(fds[0], F_SETFL, O_NONBLOCK);
+      wp->fd = fds[0];
+      wp->size = PRELOAD_BUFFER_SIZE;
+      wp->length = 0;
+      wp->buffer = Allocate(wp->size);
+      RegisterDescriptor(wp->fd, HandlePreloadData, wp);
+   }
+}
+
+/** Load icons in a worker process. */
+void RunPreloadWorker(int fd, unsigned first)
+{
+   unsigned i;
+   for(i = first; i < preloadCount; i += preloadWorkerCount) {
+      const PreloadNode *pp = preloadNodes[i];
+      PreloadRecord record;
+      ImageNode *image;
+      ImageNode *decoded;
+      IconPathNode *ip;
+      char *fileName;
+
+      /* Locate the file. */
+      image = NULL;
+      fileName = NULL;
+      preloadDeferred = 0;
+      if(pp->name[0] == '/') {
+         image = LoadIconImage(pp->name);
+         if(image) {
+            fileName = CopyString(pp->name);
+         }
+      } else {
+         for(ip = iconPaths; ip && !image && !preloadDeferred; ip = ip->next) {
+            image = LoadNamedImage(pp->name, ip->path, &fileName);
+         }
+      }
+
+      /* Decode the image unless it is too large to send. */
+      decoded = NULL;
+      if(image && image->width > 0 && image->height > 0
+         && image->width <= MAX_PRELOAD_PIXELS / image->height) {
+         decoded = LoadImage(fileName, 0, 0, 1);
+      }
+      if(decoded && (decoded->width <= 0 || decoded->height <= 0
+         || decoded->width > MAX_PRELOAD_PIXELS / decoded->height)) {
+         DestroyImage(decoded);
+         decoded = NULL;
+      }
+
+      memset(&record, 0, sizeof(record));
+      record.index = i;
+      if(decoded) {
+         record.state = PRELOAD_READY;
+         record.width = decoded->width;
+         record.height = decoded->height;
+         record.bitmap = decoded->bitmap;
+#ifdef USE_XRENDER
+         record.render = decoded->render;
+#endif
+         record.pathLength = strlen(fileName);
+         record.dataLength = GetPreloadDataLength(decoded->width,
+                                                  decoded->height,
+                                                  decoded->bitmap);
+      } else if(image || preloadDeferred) {
+         record.state = PRELOAD_DEFERRED;
+      } else {
+         record.state = PRELOAD_MISSING;
+      }
+      DestroyImage(image);
+
+      if(!WriteAll(fd, &record, sizeof(record))
+         || (decoded && !WriteAll(fd, fileName, record.pathLength))
+         || (decoded && !WriteAll(fd, decoded->data, record.dataLength))) {
+         break;
+      }
+      DestroyImage(decoded);
+      if(fileName) {
+         Release(fileName);
+      }
+   }
+   close(fd);
+}
+
+/** Write a buffer to a file descriptor. */
+char WriteAll(int fd, const void *buffer, size_t length)
+{
+   const char *ptr = buffer;
+   while(length > 0) {
+      const ssize_t rc = write(fd, ptr, length);
+      if(rc < 0) {
+         if(errno == EINTR) {
+            continue;
+         }
+         return 0;
+      }
+      ptr += rc;
+      length -= rc;
+   }
+   return 1;
+}
+
+/** Get the size of the data for an image. */
+size_t GetPreloadDataLength(int width, int height, char bitmap)
+{
+   const size_t pixels = (size_t)width * (size_t)height;
+   return bitmap ? (pixels + 7) / 8 : 4 * pixels;
+}
+
+/** Read results from a preload worker. */
+void HandlePreloadData(int fd, void *data)
+{
+   PreloadWorker *wp = (PreloadWorker*)data;
+   const unsigned worker = wp - preloadWorkers;
+   for(;;) {
+      ssize_t rc;
+
+      if(wp->length == wp->size) {
+         wp->size *= 2;
+         wp->buffer = Reallocate(wp->buffer, wp->size);
+      }
+
+      rc = read(fd, &wp->buffer[wp->length], wp->size - wp->length);
+      if(rc < 0 && errno == EINTR) {
+         continue;
+      } else if(rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+         return;
+      } else if(rc <= 0) {
+         AbandonPreloadWorker(worker);
+         return;
+      }
+      wp->length += rc;
+      if(JUNLIKELY(!ProcessPreloadRecords(wp))) {
+         Warning(_("invalid data from icon preload worker"));
+         AbandonPreloadWorker(worker);
+         return;
+      }
+   }
+}
+
+/** Store the complete results received from a preload worker.
+ * @return 1 on success, 0 if the worker sent invalid data.
+ */
+char ProcessPreloadRecords(PreloadWorker *wp)
+{
+   size_t offset = 0;
+   for(;;) {
+      PreloadRecord record;
+      size_t total;
+
+      if(wp->length - offset < sizeof(record)) {
+         break;
+      }
+      memcpy(&record, &wp->buffer[offset], sizeof(record));
+
+      /* Validate the sizes before waiting for the data. */
+      if(JUNLIKELY(record.index >= preloadCount)) {
+         return 0;
+      }
+      if(record.state == PRELOAD_READY) {
+         if(JUNLIKELY(record.width <= 0 || record.height <= 0
+               || record.width > MAX_PRELOAD_PIXELS / record.height
+               || record.pathLength == 0
+               || record.pathLength > MAX_PRELOAD_PATH
+               || record.dataLength != GetPreloadDataLength(record.width,
+                                                            record.height,
+                                                            record.bitmap))) {
+            return 0;
+         }
+      } else if(JUNLIKELY((record.state != PRELOAD_MISSING
+                           && record.state != PRELOAD_DEFERRED)
+                          || record.pathLength != 0
+                          || record.dataLength != 0)) {
+         return 0;
+      }
+
+      total = sizeof(record) + record.pathLength + record.dataLength;
+      if(wp->length - offset < total) {
+         break;
+      }
+      StorePreloadResult(&record, &wp->buffer[offset + sizeof(record)]);
+      offset += total;
+   }
+
+   wp->length -= offset;
+   memmove(wp->buffer, &wp->buffer[offset], wp->length);
+   return 1;
+}
+
+/** Store a result from a preload worker.
+ * @param record The record for the icon.
+ * @param payload The file name followed by the image data.
+ */
+void StorePreloadResult(const PreloadRecord *record, const char *payload)
+{
+   PreloadNode *pp = preloadNodes[record->index];
+
+   if(JUNLIKELY(pp->state != PRELOAD_PENDING)) {
+      return;
+   }
+
+   pp->state = record->state;
+   if(record->state == PRELOAD_READY) {
+      pp->path = Allocate(record->pathLength + 1);
+      memcpy(pp->path, payload, record->pathLength);
+      pp->path[record->pathLength] = 0;
+      pp->image = CreateImage(record->width, record->height,
+                              record->bitmap);
+      memcpy(pp->image->data, &payload[record->pathLength],
+             record->dataLength);
+#ifdef USE_XRENDER
+      pp->image->render = record->render;
+#endif
+   }
+
+   /* Show the icon if it is already in use. */
+   if(pp->icon) {
+      IconNode *icon = pp->icon;
+      pp->icon = NULL;
+      UsePreloadedImage(pp, icon);
+      FinishPendingIcon(icon);
+   }
+}
+
+/** Stop using a worker; its outstanding icons are loaded directly. */
+void AbandonPreloadWorker(unsigned worker)
+{
+   PreloadWorker *wp = &preloadWorkers[worker];
+   unsigned x;
+   if(wp->fd >= 0) {
+      UnregisterDescriptor(wp->fd);
+      close(wp->fd);
+      wp->fd = -1;
+   }
+   if(wp->buffer) {
+      Release(wp->buffer);
+      wp->buffer = NULL;
+   }
+   for(x = worker; x < preloadCount; x += preloadWorkerCount) {
+      PreloadNode *pp = preloadNodes[x];
+      if(pp->state == PRELOAD_PENDING) {
+         pp->state = PRELOAD_DEFERRED;
+         if(pp->icon) {
+            FinishPendingIcon(pp->icon);
+            pp->icon = NULL;
+         }
+      }
+   }
+}
+
+/** Stop the preload workers.
+ * Workers that are still running exit when their pipe is closed.
+ */
+void StopPreloadWorkers(void)
+{
+   unsigned x;
+   for(x = 0; x < preloadWorkerCount; x++) {
+      AbandonPreloadWorker(x);
+   }
+   preloadWorkerCount = 0;
+}
+
+/** Find the preload entry for an icon name. */
+PreloadNode *FindPreloadNode(const char *name)
+{
+   PreloadNode *pp;
+   for(pp = preloadHash[GetHash(name)]; pp; pp = pp->next) {
+      if(!strcmp(pp->name, name)) {
+         return pp;
+      }
+   }
+   return NULL;
+}
+
+/** Give the image decoded by a preload worker to an icon.
+ * The image is only used if it matches the file found for the icon;
+ * otherwise the icon is loaded when it is drawn.
+ */
+void UsePreloadedImage(PreloadNode *pp, IconNode *icon)
+{
+   if(pp->state == PRELOAD_READY) {
+      if(!strcmp(pp->path, icon->name) && icon->images == NULL
+         && icon->width == pp->image->width
+         && icon->height == pp->image->height) {
+         icon->images = pp->image;
+         icon->preloaded = 1;
+      } else {
+         DestroyImage(pp->image);
+      }
+      pp->image = NULL;
+      Release(pp->path);
+      pp->path = NULL;
+      pp->state = PRELOAD_USED;
+   }
+}
+
+/** Draw an icon that was waiting for a preload worker. */
+void FinishPendingIcon(IconNode *icon)
+{
+   icon->pending = 0;
+   iconSerial += 1;
+   RequireIconUpdate();
+}
+
+/** Get the icon serial number. */
+unsigned GetIconSerial(void)
+{
+   return iconSerial;
+}
+
+/** Remember that an icon could not be found.
+ * The list is cleared once it grows too large (for example, with many
+ * dynamic menus naming icons that do not exist).
+ */
+void InsertMissingIcon(const char *name)
+{
+   const unsigned int index = GetHash(name);
+   MissingIconNode *mp;
+   if(JUNLIKELY(missingCount >= MAX_MISSING_ICONS)) {
+      ClearMissingIcons();
+   }
+   missingCount += 1;
+   mp = Allocate(sizeof(MissingIconNode));
+   mp->name = CopyString(name);
+   mp->next = missingHash[index];
+   missingHash[index] = mp;
+}
+
+/** Determine if an icon is known to be missing. */
+char IsMissingIcon(const char *name)
+{
+   const unsigned int index = GetHash(name);
+   MissingIconNode *mp;
+   for(mp = missingHash[index]; mp; mp = mp->next) {
+      if(!strcmp(mp->name, name)) {
+         return 1;
+      }
+   }
+   return 0;
+}
+
+/** Forget all missing icons. */
+void ClearMissingIcons(void)
+{
+   unsigned int x;
+   for(x = 0; x < HASH_SIZE; x++) {
+      while(missingHash[x]) {
+         MissingIconNode *mp = missingHash[x]->next;
+         Release(missingHash[x]->name);
+         Release(missingHash[x]);
+         missingHash[x] = mp;
+      }
+   }
+   missingCount = 0;
+}
+
 /** Get the hash for a string. */
 unsigned int GetHash(const char *str)
 {
@@ -917,6 +1673,7 @@ void SetDefaultIcon(const char *name)
       Release(defaultIconName);
    }
    defaultIconName = CopyString(name);
+   PreloadIcon(name);
 }
 
 #endif /* USE_ICONS */
@@ -30,6 +30,8 @@ typedef struct ScaledIconNode {
 typedef struct IconNode {
 
    char *name;                    /**< The name of the icon. */
+   char *request;                 /**< The name searched for in the icon
+                                   *   paths (NULL if not searched). */
    struct ImageNode *images;      /**< Images associated with this icon. */
    struct ScaledIconNode *nodes;  /**< Scaled icons. */
    int width;                     /**< Natural width. */
@@ -41,7 +43,13 @@ typedef struct IconNode {
    char preserveAspect;           /**< Set to preserve the aspect ratio
                                    *   of the icon when scaling. */
    char bitmap;                   /**< Set if this is a bitmap. */
+   char scalable;                 /**< Set if the image can be rendered
+                                   *   at any size. */
    char transient;                /**< Set if this icon is transient. */
+   char pending;                  /**< Set while a preload worker is
+                                   *   decoding the image. */
+   char preloaded;                /**< Set if images was decoded by a
+                                   *   preload worker. */
 #ifdef USE_XRENDER
    char render;                   /**< Set to use render. */
 #endif
@@ -79,6 +87,14 @@ void AddIconPath(char *path);
 void PutIcon(IconNode *icon, Drawable d,
              long fg, int x, int y, int width, int height);
 
+/** Render an image at its natural size.
+ * @param image The image to render (not a bitmap).
+ * @param d The drawable on which to place the image.
+ * @param x The x offset on the drawable to render the image.
+ * @param y The y offset on the drawable to render the image.
+ */
+void PutImage(struct ImageNode *image, Drawable d, int x, int y);
+
 /** Load an icon for a client.
  * @param np The client.
  */
@@ -92,6 +108,20 @@ void LoadIcon(struct ClientNode *np);
  */
 IconNode *LoadNamedIcon(const char *name, char save, char preserveAspect);
 
+/** Request that an icon be loaded in the background during startup.
+ * This should be called while parsing the configuration for icons that
+ * will be loaded with LoadNamedIcon during startup.
+ * @param name The name of the icon.
+ */
+void PreloadIcon(const char *name);
+
+/** Get a number that changes whenever preloaded icons are loaded.
+ * Anything that keeps rendered icons should render again when this
+ * changes.
+ * @return The icon serial number.
+ */
+unsigned GetIconSerial(void);
+
 /** Load the default icon.
  * @return The default icon.
  */
@@ -115,9 +145,12 @@ void SetDefaultIcon(const char *name);
 #define DestroyIcons()                     ICON_DUMMY_FUNCTION
 #define AddIconPath( a )                   ICON_DUMMY_FUNCTION
 #define PutIcon( a, b, c, d, e, f, g )     ICON_DUMMY_FUNCTION
+#define PutImage( a, b, c, d )             ICON_DUMMY_FUNCTION
 #define LoadIcon( a )                      ICON_DUMMY_FUNCTION
 #define GetDefaultIcon()                   NULL
 #define LoadNamedIcon( a, b, c )           NULL
+#define PreloadIcon( a )                   ICON_DUMMY_FUNCTION
+#define GetIconSerial()                    0
 #define DestroyIcon( a )                   ICON_DUMMY_FUNCTION
 #define SetDefaultIcon( a )                ICON_DUMMY_FUNCTION
 
@@ -33,17 +33,24 @@
 #include "error.h"
 #include "color.h"
 #include "misc.h"
+#include "imagecache.h"
 
+static ImageNode *LoadImageFile(const char *fileName, int width, int height,
+                                char preserveAspect);
 #ifdef USE_CAIRO
 #ifdef USE_RSVG
+static RsvgHandle *OpenSVGImage(const char *fileName);
+static char ReadSVGSize(const char *fileName, int *width, int *height);
 static ImageNode *LoadSVGImage(const char *fileName, int width, int height,
                                char preserveAspect);
 #endif
 #endif
 #ifdef USE_JPEG
+static char ReadJPEGSize(const char *fileName, int *width, int *height);
 static ImageNode *LoadJPEGImage(const char *fileName, int width, int height);
 #endif
 #ifdef USE_PNG
+static char ReadPNGSize(const char *fileName, int *width, int *height);
 static ImageNode *LoadPNGImage(const char *fileName);
 #endif
 #ifdef USE_XPM
@@ -67,12 +74,31 @@ static int FreeColors(Display *d, Colormap cmap, Pixel *pixels, int n,
 ImageNode *LoadImage(const char *fileName, int width, int height,
                      char preserveAspect)
 {
-   unsigned nameLength;
-   ImageNode *result = NULL;
+   ImageNode *result;
    if(!fileName) {
+      return NULL;
+   }
+
+   /* Use the cached copy if the file hasn't changed. */
+   result = ReadImageCache(fileName, width, height, preserveAspect);
+   if(result) {
       return result;
    }
 
+   result = LoadImageFile(fileName, width, height, preserveAspect);
+   if(result) {
+      WriteImageCache(fileName, width, height, preserveAspect, result);
+   }
+   return result;
+}
+
+/** Decode an image from the specified file. */
+ImageNode *LoadImageFile(const char *fileName, int width, int height,
+                         char preserveAspect)
+{
+   unsigned nameLength;
+   ImageNode *result = NULL;
+
    nameLength = strlen(fileName);
    if(JUNLIKELY(nameLength == 0)) {
       return result;
@@ -141,6 +167,62 @@ ImageNode *LoadImage(const char *fileName, int width, int height,
 
 }
 
+/** Load the natural size of an image. */
+ImageNode *LoadImageInfo(const char *fileName)
+{
+   ImageNode *result;
+   unsigned nameLength;
+   int width, height;
+   char found;
+
+   if(!fileName) {
+      return NULL;
+   }
+
+   nameLength = strlen(fileName);
+   width = 0;
+   height = 0;
+   found = 0;
+#ifdef USE_PNG
+   if(nameLength >= 4
+      && !StrCmpNoCase(&fileName[nameLength - 4], ".png")) {
+      found = ReadPNGSize(fileName, &width, &height);
+   }
+#endif
+#ifdef USE_JPEG
+   if(   (nameLength >= 4
+            && !StrCmpNoCase(&fileName[nameLength - 4], ".jpg"))
+      || (nameLength >= 5
+            && !StrCmpNoCase(&fileName[nameLength - 5], ".jpeg"))) {
+      found = ReadJPEGSize(fileName, &width, &height);
+   }
+#endif
+#ifdef USE_CAIRO
+#ifdef USE_RSVG
+   if(nameLength >= 4
+      && !StrCmpNoCase(&fileName[nameLength - 4], ".svg")) {
+      found = ReadSVGSize(fileName, &width, &height);
+   }
+#endif
+#endif
+
+   /* Other formats are small; just load them. */
+   if(!found) {
+      return LoadImage(fileName, 0, 0, 1);
+   }
+
+   result = Allocate(sizeof(ImageNode));
+   result->next = NULL;
+   result->data = NULL;
+   result->width = width;
+   result->height = height;
+   result->bitmap = 0;
+#ifdef USE_XRENDER
+   result->render = haveRender;
+#endif
+   return result;
+}
+
 /** Load an image from a pixmap. */
 #ifdef USE_ICONS
 ImageNode *LoadImageFromDrawable(Drawable pmap, Pixmap mask)
@@ -172,6 +254,40 @@ ImageNode *LoadImageFromDrawable(Drawable pmap, Pixmap mask)
 }
 #endif
 
+/** Read the size of a PNG image from its header. */
+#ifdef USE_PNG
+char ReadPNGSize(const char *fileName, int *width, int *height)
+{
+   unsigned char header[24];
+   png_uint_32 w, h;
+   size_t count;
+   FILE *fd;
+
+   fd = fopen(fileName, "rb");
+   if(!fd) {
+      return 0;
+   }
+   count = fread(header, 1, sizeof(header), fd);
+   fclose(fd);
+
+   /* The IHDR chunk must follow the signature. */
+   if(count != sizeof(header) || png_sig_cmp(header, 0, 8)
+      || memcmp(&header[12], "IHDR", 4)) {
+      return 0;
+   }
+   w = ((png_uint_32)header[16] << 24) | ((png_uint_32)header[17] << 16)
+     | ((png_uint_32)header[18] << 8) | (png_uint_32)header[19];
+   h = ((png_uint_32)header[20] << 24) | ((png_uint_32)header[21] << 16)
+     | ((png_uint_32)header[22] << 8) | (png_uint_32)header[23];
+   if(w == 0 || w > PNG_UINT_31_MAX || h == 0 || h > PNG_UINT_31_MAX) {
+      return 0;
+   }
+   *width = (int)w;
+   *height = (int)h;
+   return 1;
+}
+#endif /* USE_PNG */
+
 /** Load a PNG image from the given file name.
  * Since libpng uses longjmp, this function is not reentrant to simplify
  * the issues surrounding longjmp and local variables.
@@ -313,6 +429,66 @@ static void JPEGErrorHandler(j_common_ptr cinfo) {
    longjmp(es->jbuffer, 1);
 }
 
+/** Read the size of a JPEG image from its frame header. */
+char ReadJPEGSize(const char *fileName, int *width, int *height)
+{
+   unsigned char buffer[5];
+   char found;
+   FILE *fd;
+   int ch;
+
+   fd = fopen(fileName, "rb");
+   if(!fd) {
+      return 0;
+   }
+   if(fgetc(fd) != 0xFF || fgetc(fd) != 0xD8) {
+      fclose(fd);
+      return 0;
+   }
+
+   found = 0;
+   for(;;) {
+      unsigned length;
+
+      /* Find the next marker. */
+      do {
+         ch = fgetc(fd);
+      } while(ch != EOF && ch != 0xFF);
+      while(ch == 0xFF) {
+         ch = fgetc(fd);
+      }
+      if(ch == EOF || ch == 0xD9 || ch == 0xDA) {
+         break;
+      }
+      if((ch >= 0xD0 && ch <= 0xD7) || ch == 0x01) {
+         continue;
+      }
+
+      if(fread(buffer, 1, 2, fd) != 2) {
+         break;
+      }
+      length = (buffer[0] << 8) | buffer[1];
+      if(length < 2) {
+         break;
+      }
+
+      /* SOFn markers, excluding DHT, JPG, and DAC. */
+      if(ch >= 0xC0 && ch <= 0xCF && ch != 0xC4 && ch != 0xC8 && ch != 0xCC) {
+         if(fread(buffer, 1, 5, fd) == 5) {
+            *height = (buffer[1] << 8) | buffer[2];
+            *width = (buffer[3] << 8) | buffer[4];
+            found = *width > 0 && *height > 0;
+         }
+         break;
+      }
+      if(fseek(fd, length - 2, SEEK_CUR)) {
+         break;
+      }
+   }
+   fclose(fd);
+   return found;
+}
+
 ImageNode *LoadJPEGImage(const char *fileName, int width, int height)
 {
    static ImageNode *result;
@@ -355,20 +531,17 @@ ImageNode *LoadJPEGImage(const char *fileName, int width, int height)
    jpeg_read_header(&cinfo, TRUE);
 
    /* Pick an appropriate scale for the image.
-    * We scale the image by the scale value for the dimension with
-    * the smallest absolute change.
+    * We use the smallest n/8 scale (n in [1..8]) that still covers the
+    * requested size in both dimensions so that the DCT does most of
+    * the downscaling.
     */
    jpeg_calc_output_dimensions(&cinfo);
-   if(width != 0 && height != 0) {
-      /* Scale using n/8 with n in [1..8]. */
-      int ratio;
-      if(abs((int)cinfo.output_width - width)
-            < abs((int)cinfo.output_height - height)) {
-         ratio = (width << 4) / cinfo.output_width;
-      } else {
-         ratio = (height << 4) / cinfo.output_height;
-      }
-      cinfo.scale_num = Max(1, Min(8, (ratio >> 2)));
+   if(width > 0 && height > 0) {
+      const int xnum = (8 * width + cinfo.output_width - 1)
+                     / cinfo.output_width;
+      const int ynum = (8 * height + cinfo.output_height - 1)
+                     / cinfo.output_height;
+      cinfo.scale_num = Max(1, Min(8, Max(xnum, ynum)));
       cinfo.scale_denom = 8;
    }
 
@@ -416,22 +589,15 @@ ImageNode *LoadJPEGImage(const char *fileName, int width, int height)
 
 #ifdef USE_CAIRO
 #ifdef USE_RSVG
-ImageNode *LoadSVGImage(const char *fileName, int width, int height,
-                        char preserveAspect)
+/** Open an SVG image. */
+RsvgHandle *OpenSVGImage(const char *fileName)
 {
 
 #if !GLIB_CHECK_VERSION(2, 35, 0)
    static char initialized = 0;
 #endif
-   ImageNode *result = NULL;
    RsvgHandle *rh;
-   RsvgDimensionData dim;
    GError *e;
-   cairo_surface_t *target;
-   cairo_t *context;
-   int stride;
-   int i;
-   float xscale, yscale;
 
    Assert(fileName);
 
@@ -447,6 +613,41 @@ ImageNode *LoadSVGImage(const char *fileName, int width, int height,
    rh = rsvg_handle_new_from_file(fileName, &e);
    if(!rh) {
       g_error_free(e);
+   }
+   return rh;
+
+}
+
+/** Read the natural size of an SVG image. */
+char ReadSVGSize(const char *fileName, int *width, int *height)
+{
+   RsvgDimensionData dim;
+   RsvgHandle *rh = OpenSVGImage(fileName);
+   if(!rh) {
+      return 0;
+   }
+   rsvg_handle_get_dimensions(rh, &dim);
+   g_object_unref(rh);
+   *width = dim.width;
+   *height = dim.height;
+   return *width > 0 && *height > 0;
+}
+
+ImageNode *LoadSVGImage(const char *fileName, int width, int height,
+                        char preserveAspect)
+{
+
+   ImageNode *result = NULL;
+   RsvgHandle *rh;
+   RsvgDimensionData dim;
+   cairo_surface_t *target;
+   cairo_t *context;
+   int stride;
+   int i;
+   float xscale, yscale;
+
+   rh = OpenSVGImage(fileName);
+   if(!rh) {
       return NULL;
    }
 
@@ -619,6 +820,62 @@ ImageNode *CreateImage(unsigned width, unsigned height, char bitmap)
    return image;
 }
 
+/** Scale part of an image.
+ * Each destination pixel is the average of the source pixels it covers
+ * (or the nearest source pixel when enlarging).
+ */
+ImageNode *ResampleImage(const ImageNode *image, int x, int y,
+                         int width, int height,
+                         int newWidth, int newHeight)
+{
+   ImageNode *result;
+   unsigned char *dest;
+   int *xstart;
+   int dx, dy;
+
+   Assert(!image->bitmap);
+   Assert(x >= 0 && x + width <= image->width);
+   Assert(y >= 0 && y + height <= image->height);
+
+   /* Precompute the first source column of each destination column. */
+   xstart = AllocateStack((newWidth + 1) * sizeof(int));
+   for(dx = 0; dx <= newWidth; dx++) {
+      xstart[dx] = x + (int)(((long)dx * width) / newWidth);
+   }
+
+   result = CreateImage(newWidth, newHeight, 0);
+   dest = result->data;
+   for(dy = 0; dy < newHeight; dy++) {
+      const int y1 = y + (int)(((long)dy * height) / newHeight);
+      const int y2 = Max(y1 + 1,
+                         y + (int)(((long)(dy + 1) * height) / newHeight));
+      for(dx = 0; dx < newWidth; dx++) {
+         unsigned long sum[4] = { 0, 0, 0, 0 };
+         const int x1 = xstart[dx];
+         const int x2 = Max(x1 + 1, xstart[dx + 1]);
+         const unsigned long count = (x2 - x1) * (y2 - y1);
+         int sx, sy, i;
+         for(sy = y1; sy < y2; sy++) {
+            const unsigned char *src = &image->data[4 * (sy * image->width
+                                                          + x1)];
+            for(sx = x1; sx < x2; sx++) {
+               sum[0] += src[0];
+               sum[1] += src[1];
+               sum[2] += src[2];
+               sum[3] += src[3];
+               src += 4;
+            }
+         }
+         for(i = 0; i < 4; i++) {
+            *dest++ = (unsigned char)(sum[i] / count);
+         }
+      }
+   }
+
+   ReleaseStack(xstart);
+   return result;
+}
+
 /** Destroy an image node. */
 void DestroyImage(ImageNode *image) {
    while(image) {
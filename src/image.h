@@ -34,6 +34,14 @@ typedef struct ImageNode {
 ImageNode *LoadImage(const char *fileName, int width, int height,
                      char preserveAspect);
 
+/** Load the natural size of an image.
+ * Where possible, only the header of the file is read, in which case
+ * the returned image has no data.
+ * @param fileName The file containing the image.
+ * @return A new image node (NULL if the image could not be loaded).
+ */
+ImageNode *LoadImageInfo(const char *fileName);
+
 /** Load an image from a Drawable.
  * @param pmap The drawable.
  * @param mask The mask (may be None).
@@ -49,6 +57,20 @@ ImageNode *LoadImageFromDrawable(Drawable pmap, Pixmap mask);
  */
 ImageNode *CreateImage(unsigned int width, unsigned int height, char bitmap);
 
+/** Scale part of an image.
+ * @param image The source image (must not be a bitmap).
+ * @param x The x-coordinate of the area to scale.
+ * @param y The y-coordinate of the area to scale.
+ * @param width The width of the area to scale.
+ * @param height The height of the area to scale.
+ * @param newWidth The width of the result.
+ * @param newHeight The height of the result.
+ * @return A newly allocated image node.
+ */
+ImageNode *ResampleImage(const ImageNode *image, int x, int y,
+                         int width, int height,
+                         int newWidth, int newHeight);
+
 /** Destroy an image node.
  * @param image The image to destroy.
  */
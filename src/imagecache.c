@@ -0,0 +1,516 @@
+/**
+ * @file imagecache.c
+ *
+ * @brief Persistent cache of decoded images.
+ *
+ * Each entry is stored in its own file in the cache directory. The file
+ * name is a hash of the image file name and requested size; the header
+ * records the source file's modification time and size so that stale
+ * entries are replaced.
+ *
+ * Rendered pixmaps (backgrounds) are stored the same way, but in the
+ * format of the root visual so that they can be uploaded directly.
+ *
+ * Entries that have not been used for a while are removed at startup,
+ * as are the least recently used entries if the cache grows too large.
+ *
+ */
+
+#include "jwm.h"
+#include "imagecache.h"
+#include "image.h"
+#include "misc.h"
+#include "main.h"
+#include "upload.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <dirent.h>
+
+/** Identifies cache entries (and their format version). */
+#define IMAGE_CACHE_MAGIC 0x4A574D31
+
+/** Identifies rendered pixmap entries. */
+#define PIXMAP_CACHE_MAGIC 0x4A574D50
+
+/** Largest image (in pixels) that is stored in the cache. */
+#define MAX_CACHED_PIXELS (256 * 256)
+
+/** Largest total size of the cache in bytes. */
+#define MAX_CACHE_SIZE (64UL * 1024 * 1024)
+
+/** Seconds after which unused entries are removed. */
+#define MAX_CACHE_AGE (30L * 24 * 60 * 60)
+
+/** Header of a cache entry.
+ * This is followed by the image file name and the image data.
+ */
+typedef struct ImageCacheHeader {
+   unsigned magic;
+   unsigned pathLength;
+   long mtime;
+   long size;
+   int requestWidth;
+   int requestHeight;
+   int width;
+   int height;
+   char preserveAspect;
+   char bitmap;
+} ImageCacheHeader;
+
+/** Header of a rendered pixmap entry.
+ * This is followed by the image file name and the pixmap contents.
+ */
+typedef struct PixmapCacheHeader {
+   unsigned magic;
+   unsigned pathLength;
+   long mtime;
+   long size;
+   unsigned long key;
+   int width;
+   int height;
+   int depth;
+   int bitsPerPixel;
+   int byteOrder;
+   int bytesPerLine;
+} PixmapCacheHeader;
+
+/** A file in the cache directory (used for pruning). */
+typedef struct CacheFileNode {
+   char *path;
+   time_t used;
+   off_t size;
+} CacheFileNode;
+
+static char *cacheDirectory = NULL;
+
+static char *GetCacheFileName(const char *prefix, const char *fileName,
+                              unsigned long key);
+static unsigned long HashValue(unsigned long hash, unsigned long value);
+static void PruneImageCache(void);
+static int CompareCacheFiles(const void *a, const void *b);
+static unsigned GetImageSize(int width, int height, char bitmap);
+static char *MapCacheFile(const char *cacheName, size_t *size);
+static void WriteCacheFile(const char *cacheName,
+                           const void *header, size_t headerSize,
+                           const char *fileName, unsigned pathLength,
+                           const void *data, size_t dataSize);
+
+/** Startup the image cache. */
+void StartupImageCache(void)
+{
+   const char *base = getenv("XDG_CACHE_HOME");
+   unsigned len;
+
+   if(base && base[0]) {
+      len = strlen(base);
+      cacheDirectory = Allocate(len + 5);
+      memcpy(cacheDirectory, base, len);
+   } else {
+      base = getenv("HOME");
+      if(JUNLIKELY(!base)) {
+         return;
+      }
+      len = strlen(base);
+      cacheDirectory = Allocate(len + 12);
+      memcpy(cacheDirectory, base, len);
+      memcpy(&cacheDirectory[len], "/.cache", 8);
+      mkdir(cacheDirectory, 0700);
+      len += 7;
+   }
+   memcpy(&cacheDirectory[len], "/jwm", 5);
+   mkdir(cacheDirectory, 0700);
+   if(JUNLIKELY(access(cacheDirectory, W_OK) != 0)) {
+      Debug("image cache disabled: %s not writable", cacheDirectory);
+      Release(cacheDirectory);
+      cacheDirectory = NULL;
+      return;
+   }
+   PruneImageCache();
+}
+
+/** Shutdown the image cache. */
+void ShutdownImageCache(void)
+{
+   if(cacheDirectory) {
+      Release(cacheDirectory);
+      cacheDirectory = NULL;
+   }
+}
+
+/** Get the name of a cache file. */
+char *GetCacheFileName(const char *prefix, const char *fileName,
+                       unsigned long key)
+{
+   const unsigned len = strlen(cacheDirectory);
+   unsigned long hash = 5381;
+   unsigned x;
+   char *result;
+
+   for(x = 0; fileName[x]; x++) {
+      hash = HashValue(hash, (unsigned char)fileName[x]);
+   }
+   hash = HashValue(hash, key);
+
+   result = Allocate(len + 32);
+   snprintf(result, len + 32, "%s/%s-%08lx", cacheDirectory, prefix,
+            hash & 0xFFFFFFFFUL);
+   return result;
+}
+
+/** Remove old entries from the cache.
+ * Entries not used for MAX_CACHE_AGE seconds are removed. If the rest
+ * are larger than MAX_CACHE_SIZE, the least recently used entries are
+ * removed until they fit.
+ */
+void PruneImageCache(void)
+{
+   const unsigned len = strlen(cacheDirectory);
+   const time_t now = time(NULL);
+   CacheFileNode *files = NULL;
+   unsigned count = 0;
+   unsigned long total = 0;
+   struct dirent *entry;
+   unsigned x;
+   DIR *dir;
+
+   dir = opendir(cacheDirectory);
+   if(JUNLIKELY(!dir)) {
+      return;
+   }
+   while((entry = readdir(dir)) != NULL) {
+      struct stat sbuf;
+      unsigned size;
+      char *path;
+
+      /* Only touch files written by the cache. */
+      if(   strncmp(entry->d_name, "img-", 4)
+         && strncmp(entry->d_name, "bg-", 3)) {
+         continue;
+      }
+
+      size = len + strlen(entry->d_name) + 2;
+      path = Allocate(size);
+      snprintf(path, size, "%s/%s", cacheDirectory, entry->d_name);
+      if(stat(path, &sbuf) != 0 || !S_ISREG(sbuf.st_mode)) {
+         Release(path);
+         continue;
+      }
+      if(now - Max(sbuf.st_atime, sbuf.st_mtime) > MAX_CACHE_AGE) {
+         unlink(path);
+         Release(path);
+         continue;
+      }
+
+      if(count == 0) {
+         files = Allocate(32 * sizeof(CacheFileNode));
+      } else if((count % 32) == 0) {
+         files = Reallocate(files, (count + 32) * sizeof(CacheFileNode));
+      }
+      files[count].path = path;
+      files[count].used = Max(sbuf.st_atime, sbuf.st_mtime);
+      files[count].size = sbuf.st_size;
+      total += sbuf.st_size;
+      count += 1;
+   }
+   closedir(dir);
+
+   if(total > MAX_CACHE_SIZE) {
+      qsort(files, count, sizeof(CacheFileNode), CompareCacheFiles);
+      for(x = 0; x < count && total > MAX_CACHE_SIZE; x++) {
+         unlink(files[x].path);
+         total -= files[x].size;
+      }
+   }
+
+   for(x = 0; x < count; x++) {
+      Release(files[x].path);
+   }
+   if(files) {
+      Release(files);
+   }
+}
+
+/** Compare cache files for sorting (least recently used first). */
+int CompareCacheFiles(const void *a, const void *b)
+{
+   const CacheFileNode *fa = (const CacheFileNode*)a;
+   const CacheFileNode *fb = (const CacheFileNode*)b;
+   if(fa->used < fb->used) {
+      return -1;
+   } else if(fa->used > fb->used) {
+      return 1;
+   }
+   return 0;
+}
+
+/** Mix a value into a hash. */
+unsigned long HashValue(unsigned long hash, unsigned long value)
+{
+   return (hash + (hash << 5)) ^ value;
+}
+
+/** Get the number of bytes of image data. */
+unsigned GetImageSize(int width, int height, char bitmap)
+{
+   if(bitmap) {
+      return (width * height + 7) / 8;
+   } else {
+      return 4 * width * height;
+   }
+}
+
+/** Map a cache file.
+ * @return The contents (NULL if the file does not exist or is empty).
+ */
+char *MapCacheFile(const char *cacheName, size_t *size)
+{
+   struct stat sbuf;
+   char *buffer;
+   int fd;
+
+   fd = open(cacheName, O_RDONLY);
+   if(fd < 0) {
+      return NULL;
+   }
+   if(JUNLIKELY(fstat(fd, &sbuf) != 0 || sbuf.st_size == 0)) {
+      close(fd);
+      return NULL;
+   }
+   buffer = mmap(NULL, sbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if(JUNLIKELY(buffer == MAP_FAILED)) {
+      return NULL;
+   }
+   *size = sbuf.st_size;
+   return buffer;
+}
+
+/** Write a cache file.
+ * The file is written to a temporary file and renamed so that readers
+ * never see a partial entry.
+ */
+void WriteCacheFile(const char *cacheName,
+                    const void *header, size_t headerSize,
+                    const char *fileName, unsigned pathLength,
+                    const void *data, size_t dataSize)
+{
+   const unsigned len = strlen(cacheName) + 16;
+   char *tempName;
+   char ok;
+   int fd;
+
+   tempName = Allocate(len);
+   snprintf(tempName, len, "%s.%d", cacheName, (int)getpid());
+   fd = open(tempName, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+   if(fd >= 0) {
+      ok = write(fd, header, headerSize) == (ssize_t)headerSize
+        && write(fd, fileName, pathLength) == (ssize_t)pathLength
+        && write(fd, data, dataSize) == (ssize_t)dataSize;
+      close(fd);
+      if(!ok || rename(tempName, cacheName) != 0) {
+         unlink(tempName);
+      }
+   }
+   Release(tempName);
+}
+
+/** Read an image from the cache. */
+ImageNode *ReadImageCache(const char *fileName, int width, int height,
+                          char preserveAspect)
+{
+   const ImageCacheHeader *header;
+   ImageNode *result;
+   struct stat source;
+   char *cacheName;
+   char *buffer;
+   size_t size;
+   unsigned pathLength;
+   unsigned long key;
+
+   if(!cacheDirectory || stat(fileName, &source) != 0) {
+      return NULL;
+   }
+
+   key = HashValue(HashValue(width, height), preserveAspect);
+   cacheName = GetCacheFileName("img", fileName, key);
+   buffer = MapCacheFile(cacheName, &size);
+   Release(cacheName);
+   if(!buffer) {
+      return NULL;
+   }
+
+   /* Make sure the entry matches the file and request.
+    * The size is checked before computing the size of the data. */
+   result = NULL;
+   header = (const ImageCacheHeader*)buffer;
+   pathLength = strlen(fileName);
+   if(   size >= sizeof(ImageCacheHeader)
+      && header->width > 0 && header->height > 0
+      && header->width <= MAX_CACHED_PIXELS / header->height
+      && header->magic == IMAGE_CACHE_MAGIC
+      && header->mtime == (long)source.st_mtime
+      && header->size == (long)source.st_size
+      && header->requestWidth == width
+      && header->requestHeight == height
+      && header->preserveAspect == preserveAspect
+      && header->pathLength == pathLength
+      && size == sizeof(ImageCacheHeader) + pathLength
+               + GetImageSize(header->width, header->height, header->bitmap)
+      && !memcmp(&buffer[sizeof(ImageCacheHeader)], fileName, pathLength)) {
+      result = CreateImage(header->width, header->height, header->bitmap);
+      memcpy(result->data, &buffer[sizeof(ImageCacheHeader) + pathLength],
+             GetImageSize(header->width, header->height, header->bitmap));
+   }
+
+   munmap(buffer, size);
+   return result;
+}
+
+/** Write an image to the cache. */
+void WriteImageCache(const char *fileName, int width, int height,
+                     char preserveAspect, const ImageNode *image)
+{
+   ImageCacheHeader header;
+   struct stat source;
+   char *cacheName;
+   unsigned long key;
+
+   if(!cacheDirectory || image->next
+      || image->width * image->height > MAX_CACHED_PIXELS
+      || stat(fileName, &source) != 0) {
+      return;
+   }
+
+   memset(&header, 0, sizeof(header));
+   header.magic = IMAGE_CACHE_MAGIC;
+   header.pathLength = strlen(fileName);
+   header.mtime = (long)source.st_mtime;
+   header.size = (long)source.st_size;
+   header.requestWidth = width;
+   header.requestHeight = height;
+   header.width = image->width;
+   header.height = image->height;
+   header.preserveAspect = preserveAspect;
+   header.bitmap = image->bitmap;
+
+   key = HashValue(HashValue(width, height), preserveAspect);
+   cacheName = GetCacheFileName("img", fileName, key);
+   WriteCacheFile(cacheName, &header, sizeof(header),
+                  fileName, header.pathLength, image->data,
+                  GetImageSize(image->width, image->height, image->bitmap));
+   Release(cacheName);
+}
+
+/** Read a rendered pixmap from the cache. */
+Pixmap ReadPixmapCache(const char *fileName, unsigned long key,
+                       int width, int height)
+{
+   const PixmapCacheHeader *header;
+   XImage *image;
+   Pixmap result;
+   struct stat source;
+   char *cacheName;
+   char *buffer;
+   size_t size;
+   unsigned pathLength;
+
+   if(!cacheDirectory || stat(fileName, &source) != 0) {
+      return None;
+   }
+
+   cacheName = GetCacheFileName("bg", fileName, key);
+   buffer = MapCacheFile(cacheName, &size);
+   Release(cacheName);
+   if(!buffer) {
+      return None;
+   }
+
+   /* The entry must match the file and request.
+    * This is checked before creating the image to upload. */
+   result = None;
+   header = (const PixmapCacheHeader*)buffer;
+   pathLength = strlen(fileName);
+   if(   size < sizeof(PixmapCacheHeader)
+      || header->magic != PIXMAP_CACHE_MAGIC
+      || header->mtime != (long)source.st_mtime
+      || header->size != (long)source.st_size
+      || header->key != key
+      || header->width != width
+      || header->height != height
+      || header->depth != rootDepth
+      || header->pathLength != pathLength
+      || size != sizeof(PixmapCacheHeader) + pathLength
+                 + (size_t)header->bytesPerLine * height
+      || memcmp(&buffer[sizeof(PixmapCacheHeader)], fileName, pathLength)) {
+      munmap(buffer, size);
+      return None;
+   }
+
+   /* The entry must also be in the format of the root visual. */
+   image = CreateUploadImage(rootDepth, width, height);
+   if(   header->bitsPerPixel == image->bits_per_pixel
+      && header->byteOrder == image->byte_order
+      && header->bytesPerLine == image->bytes_per_line) {
+      memcpy(image->data, &buffer[sizeof(PixmapCacheHeader) + pathLength],
+             (size_t)image->bytes_per_line * height);
+      result = JXCreatePixmap(display, rootWindow, width, height, rootDepth);
+      PutUploadImage(result, rootGC, image);
+   }
+   DestroyUploadImage(image);
+
+   munmap(buffer, size);
+   return result;
+}
+
+/** Write a rendered pixmap to the cache.
+ * The pixmap is read back here since its ID may be reused as soon as
+ * the background changes; writing the file (which is slow for a pixmap
+ * the size of the root window) is done by a child process.
+ */
+void WritePixmapCache(const char *fileName, unsigned long key,
+                      Pixmap pixmap, int width, int height)
+{
+   PixmapCacheHeader header;
+   struct stat source;
+   XImage *image;
+   char *cacheName;
+   pid_t pid;
+
+   if(!cacheDirectory || stat(fileName, &source) != 0) {
+      return;
+   }
+
+   image = JXGetImage(display, pixmap, 0, 0, width, height,
+                      AllPlanes, ZPixmap);
+   if(JUNLIKELY(!image)) {
+      return;
+   }
+
+   memset(&header, 0, sizeof(header));
+   header.magic = PIXMAP_CACHE_MAGIC;
+   header.pathLength = strlen(fileName);
+   header.mtime = (long)source.st_mtime;
+   header.size = (long)source.st_size;
+   header.key = key;
+   header.width = width;
+   header.height = height;
+   header.depth = image->depth;
+   header.bitsPerPixel = image->bits_per_pixel;
+   header.byteOrder = image->byte_order;
+   header.bytesPerLine = image->bytes_per_line;
+
+   cacheName = GetCacheFileName("bg", fileName, key);
+   pid = fork();
+   if(pid == 0) {
+      close(ConnectionNumber(display));
+      WriteCacheFile(cacheName, &header, sizeof(header),
+                     fileName, header.pathLength, image->data,
+                     (size_t)image->bytes_per_line * height);
+      _exit(EXIT_SUCCESS);
+   }
+   Release(cacheName);
+   JXDestroyImage(image);
+}
@@ -0,0 +1,63 @@
+/**
+ * @file imagecache.h
+ *
+ * @brief Persistent cache of decoded images.
+ *
+ */
+
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+struct ImageNode;
+
+/*@{*/
+#define InitializeImageCache()   (void)(0)
+void StartupImageCache(void);
+void ShutdownImageCache(void);
+#define DestroyImageCache()      (void)(0)
+/*@}*/
+
+/** Read an image from the cache.
+ * The entry is only used if the file has not changed since it was cached.
+ * @param fileName The file containing the image.
+ * @param width The requested width.
+ * @param height The requested height.
+ * @param preserveAspect The requested aspect ratio mode.
+ * @return A new image node (NULL if not cached).
+ */
+struct ImageNode *ReadImageCache(const char *fileName, int width, int height,
+                                 char preserveAspect);
+
+/** Write an image to the cache.
+ * @param fileName The file containing the image.
+ * @param width The requested width.
+ * @param height The requested height.
+ * @param preserveAspect The requested aspect ratio mode.
+ * @param image The decoded image.
+ */
+void WriteImageCache(const char *fileName, int width, int height,
+                     char preserveAspect, const struct ImageNode *image);
+
+/** Read a rendered pixmap from the cache.
+ * The entry is only used if the file has not changed since it was cached
+ * and the entry is in the format of the root visual.
+ * @param fileName The file the pixmap was rendered from.
+ * @param key Identifies how the pixmap was rendered.
+ * @param width The width of the pixmap.
+ * @param height The height of the pixmap.
+ * @return A new pixmap (None if not cached).
+ */
+Pixmap ReadPixmapCache(const char *fileName, unsigned long key,
+                       int width, int height);
+
+/** Write a rendered pixmap to the cache.
+ * @param fileName The file the pixmap was rendered from.
+ * @param key Identifies how the pixmap was rendered.
+ * @param pixmap The pixmap.
+ * @param width The width of the pixmap.
+ * @param height The height of the pixmap.
+ */
+void WritePixmapCache(const char *fileName, unsigned long key,
+                      Pixmap pixmap, int width, int height);
+
+#endif /* IMAGECACHE_H */
@@ -330,6 +330,18 @@
 
 #define JXShapeSelectInput( a, b, c ) JFUNC3(XShapeSelectInput, a, b, c)
 
+#define JXShmAttach( a, b ) JFUNC2(XShmAttach, a, b)
+
+#define JXShmCreateImage( a, b, c, d, e, f, g, h ) \
+   JFUNC8(XShmCreateImage, a, b, c, d, e, f, g, h)
+
+#define JXShmDetach( a, b ) JFUNC2(XShmDetach, a, b)
+
+#define JXShmPutImage( a, b, c, d, e, f, g, h, i, j, k ) \
+   JFUNC11(XShmPutImage, a, b, c, d, e, f, g, h, i, j, k)
+
+#define JXShmQueryExtension( a ) JFUNC1(XShmQueryExtension, a)
+
 #define JXStoreName( a, b, c ) JFUNC3(XStoreName, a, b, c)
 
 #define JXStringToKeysym( a ) JFUNC1(XStringToKeysym, a)
@@ -391,6 +403,11 @@
 
 #define JXftDrawSetClip( a, b ) JFUNC2(XftDrawSetClip, a, b)
 
+#define JXftDrawGlyphs( a, b, c, d, e, f, g ) \
+   JFUNC7(XftDrawGlyphs, a, b, c, d, e, f, g)
+
+#define JXftCharIndex( a, b, c ) JFUNC3(XftCharIndex, a, b, c)
+
 /* Xrender */
 
 #define JXRenderQueryExtension( a, b, c ) \
@@ -410,7 +427,36 @@
 
 #define JXRenderFreePicture( a, b ) JFUNC2(XRenderFreePicture, a, b)
 
+#define JXRenderSetPictureTransform( a, b, c ) \
+   JFUNC3(XRenderSetPictureTransform, a, b, c)
+
+#define JXRenderSetPictureFilter( a, b, c, d, e ) \
+   JFUNC5(XRenderSetPictureFilter, a, b, c, d, e)
+
 #define JXRenderComposite( a, b, c, d, e, f, g, h, i, j, k, l, m ) \
    JFUNC13(XRenderComposite, a, b, c, d, e, f, g, h, i, j, k, l, m)
 
+/* Composite and Damage */
+
+#define JXCompositeQueryExtension( a, b, c ) \
+   JFUNC3(XCompositeQueryExtension, a, b, c)
+
+#define JXCompositeRedirectSubwindows( a, b, c ) \
+   JFUNC3(XCompositeRedirectSubwindows, a, b, c)
+
+#define JXCompositeUnredirectSubwindows( a, b, c ) \
+   JFUNC3(XCompositeUnredirectSubwindows, a, b, c)
+
+#define JXCompositeNameWindowPixmap( a, b ) \
+   JFUNC2(XCompositeNameWindowPixmap, a, b)
+
+#define JXDamageQueryExtension( a, b, c ) \
+   JFUNC3(XDamageQueryExtension, a, b, c)
+
+#define JXDamageCreate( a, b, c ) JFUNC3(XDamageCreate, a, b, c)
+
+#define JXDamageDestroy( a, b ) JFUNC2(XDamageDestroy, a, b)
+
+#define JXDamageSubtract( a, b, c, d ) JFUNC4(XDamageSubtract, a, b, c, d)
+
 #endif /* JXLIB_H */
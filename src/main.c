@@ -24,14 +24,18 @@
 #include "group.h"
 #include "key.h"
 #include "icon.h"
+#include "imagecache.h"
+#include "upload.h"
 #include "taskbar.h"
 #include "tray.h"
 #include "traybutton.h"
 #include "popup.h"
 #include "pager.h"
 #include "swallow.h"
+#include "thumbnail.h"
 #include "screen.h"
 #include "root.h"
+#include "dynamic.h"
 #include "desktop.h"
 #include "place.h"
 #include "clock.h"
@@ -494,15 +498,20 @@ void Initialize(void)
    InitializeGroups();
    InitializeHints();
    InitializeIcons();
+   InitializeImageCache();
+   InitializeUpload();
    InitializeKeys();
    InitializePager();
    InitializePlacement();
    InitializePopup();
    InitializeRootMenu();
+   InitializeDynamicMenus();
    InitializeScreens();
    InitializeSettings();
    InitializeSwallow();
    InitializeTaskBar();
+   InitializeThumbnails();
+   InitializeTiming();
    InitializeTray();
    InitializeTrayButtons();
 }
@@ -525,11 +534,15 @@ void Startup(void)
    StartupGroups();
    StartupColors();
    StartupFonts();
+   StartupImageCache();
+   StartupUpload();
    StartupIcons();
    StartupBackgrounds();
    StartupCursors();
 
    StartupPager();
+   StartupThumbnails();
+   StartupTiming();
    StartupClock();
    StartupTaskBar();
    StartupTrayButtons();
@@ -548,6 +561,7 @@ void Startup(void)
    StartupPopup();
 
    StartupRootMenu();
+   StartupDynamicMenus();
 
    SetDefaultCursor(rootWindow);
    ReadCurrentDesktop();
@@ -590,16 +604,21 @@ void Shutdown(void)
    ShutdownPopup();
    ShutdownKeys();
    ShutdownPager();
+   ShutdownThumbnails();
    ShutdownRootMenu();
+   ShutdownDynamicMenus();
    ShutdownDock();
    ShutdownTray();
    ShutdownTrayButtons();
    ShutdownTaskBar();
    ShutdownClock();
+   ShutdownTiming();
    ShutdownBorders();
    ShutdownClients();
    ShutdownBackgrounds();
    ShutdownIcons();
+   ShutdownImageCache();
+   ShutdownUpload();
    ShutdownCursors();
    ShutdownFonts();
    ShutdownColors();
@@ -637,15 +656,20 @@ void Destroy(void)
    DestroyGroups();
    DestroyHints();
    DestroyIcons();
+   DestroyImageCache();
+   DestroyUpload();
    DestroyKeys();
    DestroyPager();
    DestroyPlacement();
    DestroyPopup();
    DestroyRootMenu();
+   DestroyDynamicMenus();
    DestroyScreens();
    DestroySettings();
    DestroySwallow();
    DestroyTaskBar();
+   DestroyThumbnails();
+   DestroyTiming();
    DestroyTray();
    DestroyTrayButtons();
 }
@@ -25,6 +25,7 @@
 #include "hint.h"
 #include "misc.h"
 #include "popup.h"
+#include "dynamic.h"
 
 #define BASE_ICON_OFFSET   3
 #define MENU_BORDER_SIZE   1
@@ -43,6 +44,11 @@ static void UnpatchMenu(Menu *menu);
 static void CreateMenu(Menu *menu, int x, int y, char keyboard);
 static void HideMenu(Menu *menu);
 static void DrawMenu(Menu *menu);
+static void PrepareMenu(Menu *menu);
+static void RenderMenu(Menu *menu, Pixmap d, char active,
+                       int top, int bottom);
+static void ScrollMenuPixmap(Menu *menu, Pixmap d, char active, int delta);
+static void CopyMenuItem(Menu *menu, int index, char active);
 
 static char MenuLoop(Menu *menu, RunMenuCommandType runner);
 static void MenuCallback(const TimeType *now, int x, int y,
@@ -52,16 +58,21 @@ static MenuSelectionType UpdateMotion(Menu *menu,
                                       XEvent *event);
 
 static void UpdateMenu(Menu *menu);
-static void DrawMenuItem(Menu *menu, MenuItem *item, int index);
+static void DrawMenuItem(Menu *menu, Pixmap d, MenuItem *item, int index,
+                         char active);
 static MenuItem *GetMenuItem(Menu *menu, int index);
 static int GetNextMenuIndex(Menu *menu);
 static int GetPreviousMenuIndex(Menu *menu);
 static int GetMenuIndex(Menu *menu, int index);
 static void SetPosition(Menu *tp, int index);
 static char IsMenuValid(const Menu *menu);
+static char HasSubmenuArrow(const MenuItem *item);
 
 int menuShown = 0;
 
+/** The innermost menu being shown. */
+static Menu *activeMenu = NULL;
+
 /** Create an empty menu item. */
 MenuItem *CreateMenuItem(MenuItemType type)
 {
@@ -83,6 +94,12 @@ void InitializeMenu(Menu *menu)
 
    menu->textOffset = 0;
    menu->itemCount = 0;
+   menu->pixmap = None;
+   menu->activePixmap = None;
+   menu->scroll = 0;
+   menu->viewHeight = 0;
+   menu->iconSerial = 0;
+   menu->itemArray = NULL;
 
    /* Compute the max size needed */
    hasIcon = 0;
@@ -134,10 +151,12 @@ void InitializeMenu(Menu *menu)
    }
 
    menu->offsets = Allocate(sizeof(int) * menu->itemCount);
+   menu->itemArray = Allocate(sizeof(MenuItem*) * menu->itemCount);
 
    hasSubmenu = 0;
    index = 0;
    for(np = menu->items; np; np = np->next) {
+      menu->itemArray[index] = np;
       menu->offsets[index++] = menu->height;
       if(np->type == MENU_ITEM_SEPARATOR) {
          menu->height += 6;
@@ -153,8 +172,10 @@ void InitializeMenu(Menu *menu)
       if(hasIcon && !np->icon) {
          np->icon = &emptyIcon;
       }
-      if(np->submenu) {
+      if(HasSubmenuArrow(np)) {
          hasSubmenu = (menu->itemHeight + 3) / 4;
+      }
+      if(np->submenu) {
          InitializeMenu(np->submenu);
       }
    }
@@ -233,9 +254,13 @@ void DestroyMenu(Menu *menu)
             Release(menu->items->tooltip);
          }
          switch(menu->items->action.type & MA_ACTION_MASK) {
+         case MA_DYNAMIC:
+            /* The submenu belongs to the dynamic menu. */
+            DestroyDynamicMenu(menu->items->action.context);
+            menu->items->submenu = NULL;
+            /* Fall through. */
          case MA_EXECUTE:
          case MA_EXIT:
-         case MA_DYNAMIC:
             if(menu->items->action.str) {
                Release(menu->items->action.str);
             }
@@ -258,16 +283,66 @@ void DestroyMenu(Menu *menu)
       if(menu->offsets) {
          Release(menu->offsets);
       }
+      if(menu->itemArray) {
+         Release(menu->itemArray);
+      }
+      if(menu->pixmap != None) {
+         JXFreePixmap(display, menu->pixmap);
+         JXFreePixmap(display, menu->activePixmap);
+      }
       Release(menu);
    }
 }
 
+/** Open the submenu of a menu item if the item is selected. */
+void OpenSelectedSubmenu(MenuItem *item)
+{
+   Menu *menu = activeMenu;
+   XEvent event;
+
+   if(!menu || GetMenuItem(menu, menu->currentIndex) != item) {
+      return;
+   }
+
+   /* The submenu is opened by the next motion event, so send one for
+    * the selected item in case the mouse doesn't move again. */
+   memset(&event, 0, sizeof(event));
+   event.xmotion.type = MotionNotify;
+   event.xmotion.display = display;
+   event.xmotion.window = menu->window;
+   event.xmotion.root = rootWindow;
+   event.xmotion.time = CurrentTime;
+   event.xmotion.same_screen = True;
+   event.xmotion.x_root = menu->x + menu->width / 2;
+   event.xmotion.y_root = menu->y + menu->offsets[menu->currentIndex]
+                        + menu->itemHeight / 2;
+   JXPutBackEvent(display, &event);
+}
+
+/** Release the rendered pixmaps of a menu and its submenus. */
+void ReleaseMenuPixmaps(Menu *menu)
+{
+   MenuItem *np;
+   if(menu->pixmap != None) {
+      JXFreePixmap(display, menu->pixmap);
+      JXFreePixmap(display, menu->activePixmap);
+      menu->pixmap = None;
+      menu->activePixmap = None;
+   }
+   for(np = menu->items; np; np = np->next) {
+      if(np->submenu) {
+         ReleaseMenuPixmaps(np->submenu);
+      }
+   }
+}
+
 /** Show a submenu. */
 char ShowSubmenu(Menu *menu, Menu *parent,
                  RunMenuCommandType runner,
                  int x, int y, char keyboard)
 {
 
+   Menu *previous = activeMenu;
    char status;
 
    PatchMenu(menu);
@@ -275,11 +350,12 @@ char ShowSubmenu(Menu *menu, Menu *parent,
    CreateMenu(menu, x, y, keyboard);
 
    menuShown += 1;
+   activeMenu = menu;
    status = MenuLoop(menu, runner);
+   activeMenu = previous;
    menuShown -= 1;
 
    JXDestroyWindow(display, menu->window);
-   JXFreePixmap(display, menu->pixmap);
 
    return status;
 
@@ -305,10 +381,7 @@ void PatchMenu(Menu *menu)
          submenu = CreateWindowMenu(item->action.context);
          break;
       case MA_DYNAMIC:
-         if(!item->submenu) {
-            submenu = ParseDynamicMenu(item->action.str);
-            submenu->itemHeight = item->action.value;
-         }
+         PrefetchDynamicMenu(item);
          break;
       default:
          break;
@@ -331,7 +404,6 @@ void UnpatchMenu(Menu *menu)
          case MA_DESKTOP_MENU:
          case MA_SENDTO_MENU:
          case MA_WINDOW_MENU:
-         case MA_DYNAMIC:
             DestroyMenu(item->submenu);
             item->submenu = NULL;
             break;
@@ -339,6 +411,10 @@ void UnpatchMenu(Menu *menu)
             break;
          }
       }
+      if((item->action.type & MA_ACTION_MASK) == MA_DYNAMIC) {
+         /* This also covers menus whose program is still running. */
+         ReleaseDynamicMenu(item);
+      }
    }
 }
 
@@ -449,8 +525,16 @@ char MenuLoop(Menu *menu, RunMenuCommandType runner)
 void MenuCallback(const TimeType *now, int x, int y, Window w, void *data)
 {
    Menu *menu = data;
+   Menu *mp;
    MenuItem *item;
-   int i;
+
+   /* Show icons that finished loading while the menu was shown. */
+   for(mp = activeMenu; mp; mp = mp->parent) {
+      if(mp->iconSerial != GetIconSerial()) {
+         PrepareMenu(mp);
+         DrawMenu(mp);
+      }
+   }
 
    /* Check if the mouse moved (and reset if it did). */
    if(   abs(menu->mousex - x) > settings.doubleClickDelta
@@ -477,10 +561,7 @@ void MenuCallback(const TimeType *now, int x, int y, Window w, void *data)
       if(menu->currentIndex < 0) {
          return;
       }
-      item = menu->items;
-      for(i = 0; i < menu->currentIndex; i++) {
-         item = item->next;
-      }
+      item = GetMenuItem(menu, menu->currentIndex);
       if(item->type != MENU_ITEM_SUBMENU) {
          return;
       }
@@ -489,10 +570,7 @@ void MenuCallback(const TimeType *now, int x, int y, Window w, void *data)
    if(menu->currentIndex < 0) {
       return;
    }
-   item = menu->items;
-   for(i = 0; i < menu->currentIndex; i++) {
-      item = item->next;
-   }
+   item = GetMenuItem(menu, menu->currentIndex);
    if(item->tooltip) {
       ShowPopup(x, y, item->tooltip, POPUP_MENU);
    }
@@ -536,20 +614,21 @@ void CreateMenu(Menu *menu, int x, int y, char keyboard)
    attrMask |= CWEventMask;
    attr.event_mask = ExposureMask;
 
-   attrMask |= CWBackPixel;
-   attr.background_pixel = colors[COLOR_MENU_BG];
+   PrepareMenu(menu);
+
+   attrMask |= CWBackPixmap;
+   attr.background_pixmap = menu->pixmap;
 
    attrMask |= CWSaveUnder;
    attr.save_under = True;
 
-   menu->window = JXCreateWindow(display, rootWindow, x, y,
-                                 menu->width, menu->height, 0,
+   menu->window = JXCreateWindow(display, rootWindow,
+                                 x, y + menu->scroll,
+                                 menu->width, menu->viewHeight, 0,
                                  CopyFromParent, InputOutput,
                                  CopyFromParent, attrMask, &attr);
    SetAtomAtom(menu->window, ATOM_NET_WM_WINDOW_TYPE,
                ATOM_NET_WM_WINDOW_TYPE_MENU);
-   menu->pixmap = JXCreatePixmap(display, menu->window,
-                                 menu->width, menu->height, rootDepth);
 
    if(settings.menuOpacity < UINT_MAX) {
       SetCardinalAtom(menu->window, ATOM_NET_WM_WINDOW_OPACITY,
@@ -562,7 +641,7 @@ void CreateMenu(Menu *menu, int x, int y, char keyboard)
       const int y = menu->offsets[0] + menu->itemHeight / 2;
       menu->lastIndex = 0;
       menu->currentIndex = 0;
-      MoveMouse(menu->window, menu->itemHeight / 2, y);
+      MoveMouse(menu->window, menu->itemHeight / 2, y - menu->scroll);
    } else {
       menu->lastIndex = -1;
       menu->currentIndex = -1;
@@ -570,47 +649,171 @@ void CreateMenu(Menu *menu, int x, int y, char keyboard)
 
 }
 
-/** Draw a menu. */
+/** Draw a menu from its rendered pixmaps. */
 void DrawMenu(Menu *menu)
 {
+   JXCopyArea(display, menu->pixmap, menu->window, rootGC,
+              0, 0, menu->width, menu->viewHeight, 0, 0);
+   if(menu->currentIndex >= 0) {
+      CopyMenuItem(menu, menu->currentIndex, 1);
+   }
+}
 
-   MenuItem *np;
-   int x;
+/** Render the visible part of a menu.
+ * Menus that fit on the screen are rendered once and kept. Taller menus
+ * only render the items in the window. When scrolled, the rendered
+ * items are moved and only the items scrolled into view are rendered.
+ */
+void PrepareMenu(Menu *menu)
+{
+   const int viewHeight = Min(menu->height, menu->screen->height);
+   const int scroll = Max(0, Min(menu->screen->y - menu->y,
+                                 menu->height - viewHeight));
+   const int delta = scroll - menu->scroll;
+
+   if(menu->pixmap != None && menu->viewHeight != viewHeight) {
+      JXFreePixmap(display, menu->pixmap);
+      JXFreePixmap(display, menu->activePixmap);
+      menu->pixmap = None;
+      menu->activePixmap = None;
+   }
+   if(menu->pixmap == None) {
+      menu->viewHeight = viewHeight;
+      menu->pixmap = JXCreatePixmap(display, rootWindow,
+                                    menu->width, viewHeight, rootDepth);
+      menu->activePixmap = JXCreatePixmap(display, rootWindow,
+                                          menu->width, viewHeight,
+                                          rootDepth);
+   } else if(menu->iconSerial == GetIconSerial()) {
+      if(delta == 0) {
+         return;
+      }
+      if(abs(delta) < viewHeight - 2 * MENU_BORDER_SIZE) {
+         menu->scroll = scroll;
+         ScrollMenuPixmap(menu, menu->pixmap, 0, delta);
+         ScrollMenuPixmap(menu, menu->activePixmap, 1, delta);
+         return;
+      }
+   }
+
+   menu->scroll = scroll;
+   menu->iconSerial = GetIconSerial();
+   RenderMenu(menu, menu->pixmap, 0, 0, viewHeight);
+   RenderMenu(menu, menu->activePixmap, 1, 0, viewHeight);
+}
+
+/** Move the contents of a rendered menu pixmap after scrolling.
+ * @param menu The menu (scroll is already updated).
+ * @param d The pixmap.
+ * @param active Set if the pixmap has every item highlighted.
+ * @param delta The change in scroll.
+ */
+void ScrollMenuPixmap(Menu *menu, Pixmap d, char active, int delta)
+{
+   const int inner = menu->viewHeight - 2 * MENU_BORDER_SIZE;
+   if(delta > 0) {
+      JXCopyArea(display, d, d, rootGC,
+                 0, MENU_BORDER_SIZE + delta, menu->width, inner - delta,
+                 0, MENU_BORDER_SIZE);
+      RenderMenu(menu, d, active,
+                 MENU_BORDER_SIZE + inner - delta, menu->viewHeight);
+   } else {
+      JXCopyArea(display, d, d, rootGC,
+                 0, MENU_BORDER_SIZE, menu->width, inner + delta,
+                 0, MENU_BORDER_SIZE - delta);
+      RenderMenu(menu, d, active, 0, MENU_BORDER_SIZE - delta);
+   }
+}
+
+/** Render part of the visible part of a menu.
+ * Items are always drawn completely, so the area is extended to cover
+ * every item that overlaps it.
+ * @param menu The menu.
+ * @param d The pixmap to render to.
+ * @param active Set to render every item highlighted.
+ * @param top The top of the area to render (relative to the window).
+ * @param bottom The bottom of the area to render.
+ */
+void RenderMenu(Menu *menu, Pixmap d, char active, int top, int bottom)
+{
+
+   const int scroll = menu->scroll;
+   char hasLabel;
+   int first, last;
+   int index;
+
+   /* Determine the items to draw (in menu coordinates). */
+   top += scroll;
+   bottom += scroll;
+   hasLabel = menu->label && top < MENU_BORDER_SIZE + menu->itemHeight;
+   if(hasLabel) {
+      top = 0;
+   }
+   first = Max(0, GetMenuIndex(menu, top));
+   last = first;
+   while(last < menu->itemCount && menu->offsets[last] < bottom) {
+      last += 1;
+   }
+   if(first < last) {
+      top = Min(top, menu->offsets[first]);
+      if(last < menu->itemCount) {
+         bottom = Max(bottom, menu->offsets[last]);
+      } else {
+         bottom = menu->height;
+      }
+   }
+   top = Max(0, top - scroll);
+   bottom = Min(menu->viewHeight, bottom - scroll);
 
    JXSetForeground(display, rootGC, colors[COLOR_MENU_BG]);
-   JXFillRectangle(display, menu->pixmap, rootGC, 0, 0,
-                   menu->width, menu->height);
+   JXFillRectangle(display, d, rootGC, 0, top, menu->width, bottom - top);
+
+   if(hasLabel) {
+      DrawMenuItem(menu, d, NULL, -1, 0);
+   }
+   for(index = first; index < last; index++) {
+      DrawMenuItem(menu, d, menu->itemArray[index], index, active);
+   }
 
+   /* The border is drawn last since partial items may overlap it. */
    if(settings.menuDecorations == DECO_MOTIF) {
       JXSetForeground(display, rootGC, colors[COLOR_MENU_UP]);
-      JXDrawLine(display, menu->pixmap, rootGC,
-                 0, 0, menu->width, 0);
-      JXDrawLine(display, menu->pixmap, rootGC,
-                 0, 0, 0, menu->height);
+      JXDrawLine(display, d, rootGC, 0, 0, menu->width, 0);
+      JXDrawLine(display, d, rootGC, 0, 0, 0, menu->viewHeight);
 
       JXSetForeground(display, rootGC, colors[COLOR_MENU_DOWN]);
-      JXDrawLine(display, menu->pixmap, rootGC,
-                 0, menu->height - 1, menu->width, menu->height - 1);
-      JXDrawLine(display, menu->pixmap, rootGC,
-                 menu->width - 1, 0, menu->width - 1, menu->height);
+      JXDrawLine(display, d, rootGC, 0, menu->viewHeight - 1,
+                 menu->width, menu->viewHeight - 1);
+      JXDrawLine(display, d, rootGC,
+                 menu->width - 1, 0, menu->width - 1, menu->viewHeight);
    } else {
       JXSetForeground(display, rootGC, colors[COLOR_MENU_DOWN]);
-      JXDrawRectangle(display, menu->pixmap, rootGC,
-                      0, 0, menu->width - 1, menu->height - 1);
+      JXDrawRectangle(display, d, rootGC,
+                      0, 0, menu->width - 1, menu->viewHeight - 1);
    }
 
-   if(menu->label) {
-      DrawMenuItem(menu, NULL, -1);
-   }
+}
 
-   x = 0;
-   for(np = menu->items; np; np = np->next) {
-      DrawMenuItem(menu, np, x);
-      ++x;
-   }
-   JXCopyArea(display, menu->pixmap, menu->window, rootGC,
-              0, 0, menu->width, menu->height, 0, 0);
+/** Copy a menu item from a rendered pixmap to the menu window. */
+void CopyMenuItem(Menu *menu, int index, char active)
+{
+   const Pixmap d = active ? menu->activePixmap : menu->pixmap;
+   int top = menu->offsets[index] - menu->scroll;
+   int bottom;
 
+   if(index + 1 < menu->itemCount) {
+      bottom = menu->offsets[index + 1] - menu->scroll;
+   } else {
+      bottom = menu->height - MENU_BORDER_SIZE - menu->scroll;
+   }
+   top = Max(top, 0);
+   bottom = Min(bottom, menu->viewHeight);
+   if(top < bottom) {
+      JXCopyArea(display, d, menu->window, rootGC,
+                 MENU_BORDER_SIZE, top,
+                 menu->width - MENU_BORDER_SIZE * 2, bottom - top,
+                 MENU_BORDER_SIZE, top);
+   }
 }
 
 /** Determine the action to take given an event. */
@@ -790,36 +993,33 @@ MenuSelectionType UpdateMotion(Menu *menu,
 void UpdateMenu(Menu *menu)
 {
 
-   MenuItem *ip;
-
    /* Clear the old selection. */
-   ip = GetMenuItem(menu, menu->lastIndex);
-   DrawMenuItem(menu, ip, menu->lastIndex);
+   if(menu->lastIndex >= 0) {
+      CopyMenuItem(menu, menu->lastIndex, 0);
+   }
 
    /* Highlight the new selection. */
-   ip = GetMenuItem(menu, menu->currentIndex);
-   if(ip != NULL) {
-      DrawMenuItem(menu, ip, menu->currentIndex);
+   if(menu->currentIndex >= 0) {
+      CopyMenuItem(menu, menu->currentIndex, 1);
    }
 
-   JXCopyArea(display, menu->pixmap, menu->window, rootGC,
-              0, 0, menu->width, menu->height, 0, 0);
-
 }
 
 /** Draw a menu item. */
-void DrawMenuItem(Menu *menu, MenuItem *item, int index)
+void DrawMenuItem(Menu *menu, Pixmap d, MenuItem *item, int index,
+                  char active)
 {
 
    ButtonNode button;
+   int top;
 
    Assert(menu);
 
    if(!item) {
       if(index == -1 && menu->label) {
-         ResetButton(&button, menu->pixmap);
+         ResetButton(&button, d);
          button.x = MENU_BORDER_SIZE;
-         button.y = MENU_BORDER_SIZE;
+         button.y = MENU_BORDER_SIZE - menu->scroll;
          button.width = menu->width - MENU_BORDER_SIZE * 2;
          button.height = menu->itemHeight - 1;
          button.font = FONT_MENU;
@@ -831,11 +1031,12 @@ void DrawMenuItem(Menu *menu, MenuItem *item, int index)
       return;
    }
 
+   top = menu->offsets[index] - menu->scroll;
    if(item->type != MENU_ITEM_SEPARATOR) {
       ColorType fg;
 
-      ResetButton(&button, menu->pixmap);
-      if(menu->currentIndex == index) {
+      ResetButton(&button, d);
+      if(active) {
          button.type = BUTTON_MENU_ACTIVE;
          fg = COLOR_MENU_ACTIVE_FG;
       } else {
@@ -844,7 +1045,7 @@ void DrawMenuItem(Menu *menu, MenuItem *item, int index)
       }
 
       button.x = MENU_BORDER_SIZE;
-      button.y = menu->offsets[index];
+      button.y = top;
       button.font = FONT_MENU;
       button.width = menu->width - MENU_BORDER_SIZE * 2;
       button.height = menu->itemHeight;
@@ -852,10 +1053,10 @@ void DrawMenuItem(Menu *menu, MenuItem *item, int index)
       button.icon = item->icon;
       DrawButton(&button);
 
-      if(item->submenu) {
+      if(HasSubmenuArrow(item)) {
 
          const int asize = (menu->itemHeight + 7) / 8;
-         const int y = menu->offsets[index] + (menu->itemHeight + 1) / 2;
+         const int y = top + (menu->itemHeight + 1) / 2;
          int x = menu->width - 2 * asize - 1;
          int i;
 
@@ -863,28 +1064,25 @@ void DrawMenuItem(Menu *menu, MenuItem *item, int index)
          for(i = 0; i < asize; i++) {
             const int y1 = y - asize + i;
             const int y2 = y + asize - i;
-            JXDrawLine(display, menu->pixmap, rootGC, x, y1, x, y2);
+            JXDrawLine(display, d, rootGC, x, y1, x, y2);
             x += 1;
          }
-         JXDrawPoint(display, menu->pixmap, rootGC, x, y);
+         JXDrawPoint(display, d, rootGC, x, y);
 
       }
 
    } else {
       if(settings.menuDecorations == DECO_MOTIF) {
          JXSetForeground(display, rootGC, colors[COLOR_MENU_DOWN]);
-         JXDrawLine(display, menu->pixmap, rootGC, 4,
-                    menu->offsets[index] + 2, menu->width - 6,
-                    menu->offsets[index] + 2);
+         JXDrawLine(display, d, rootGC,
+                    4, top + 2, menu->width - 6, top + 2);
          JXSetForeground(display, rootGC, colors[COLOR_MENU_UP]);
-         JXDrawLine(display, menu->pixmap, rootGC, 4,
-                    menu->offsets[index] + 3, menu->width - 6,
-                    menu->offsets[index] + 3);
+         JXDrawLine(display, d, rootGC,
+                    4, top + 3, menu->width - 6, top + 3);
       } else {
          JXSetForeground(display, rootGC, colors[COLOR_MENU_FG]);
-         JXDrawLine(display, menu->pixmap, rootGC, 4,
-                    menu->offsets[index] + 2, menu->width - 6,
-                    menu->offsets[index] + 2);
+         JXDrawLine(display, d, rootGC,
+                    4, top + 2, menu->width - 6, top + 2);
       }
    }
 
@@ -930,39 +1128,35 @@ int GetPreviousMenuIndex(Menu *menu)
 int GetMenuIndex(Menu *menu, int y)
 {
 
-   int x;
+   int low, high;
 
    if(y < menu->offsets[0]) {
       return -1;
    }
-   for(x = 0; x < menu->itemCount - 1; x++) {
-      if(y >= menu->offsets[x] && y < menu->offsets[x + 1]) {
-         return x;
+
+   /* Find the last item starting at or above y. */
+   low = 0;
+   high = menu->itemCount - 1;
+   while(low < high) {
+      const int mid = (low + high + 1) / 2;
+      if(y >= menu->offsets[mid]) {
+         low = mid;
+      } else {
+         high = mid - 1;
       }
    }
-   return x;
+   return low;
 
 }
 
 /** Get the menu item associated with an index. */
 MenuItem *GetMenuItem(Menu *menu, int index)
 {
-
-   MenuItem *ip;
-
-   if(index >= 0) {
-      for(ip = menu->items; ip; ip = ip->next) {
-         if(!index) {
-            return ip;
-         }
-         --index;
-      }
+   if(index >= 0 && index < menu->itemCount) {
+      return menu->itemArray[index];
    } else {
-      ip = NULL;
+      return NULL;
    }
-
-   return ip;
-
 }
 
 /** Set the active menu item. */
@@ -981,7 +1175,9 @@ void SetPosition(Menu *tp, int index)
          updated = -tp->itemHeight;
       }
       if(updated) {
-         JXMoveWindow(display, tp->window, tp->x, tp->y);
+         PrepareMenu(tp);
+         JXMoveWindow(display, tp->window, tp->x, tp->y + tp->scroll);
+         DrawMenu(tp);
          y += updated;
       }
 
@@ -989,6 +1185,7 @@ void SetPosition(Menu *tp, int index)
 
    /* We need to do this twice so the event gets registered
     * on the submenu if one exists. */
+   y -= tp->scroll;
    MoveMouse(tp->window, tp->itemHeight / 2, y);
    MoveMouse(tp->window, tp->itemHeight / 2, y);
 
@@ -1008,3 +1205,13 @@ char IsMenuValid(const Menu *menu)
    return 0;
 }
 
+
+/** Determine if a menu item is drawn with a submenu arrow.
+ * Dynamic menus get the arrow before their submenu is attached since
+ * the menu is rendered only once.
+ */
+char HasSubmenuArrow(const MenuItem *item)
+{
+   return item->submenu != NULL
+       || (item->action.type & MA_ACTION_MASK) == MA_DYNAMIC;
+}
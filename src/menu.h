@@ -87,7 +87,11 @@ typedef struct Menu {
 
    /* These fields are handled by menu.c */
    Window window;          /**< The menu window. */
-   Pixmap pixmap;          /**< Pixmap where the menu is rendered. */
+   Pixmap pixmap;          /**< The visible part rendered (or None). */
+   Pixmap activePixmap;    /**< The visible part with items highlighted. */
+   int scroll;             /**< y-offset of the visible part. */
+   int viewHeight;         /**< Height of the menu window. */
+   unsigned iconSerial;    /**< Icon serial number when rendered. */
    int x;                  /**< The x-coordinate of the menu. */
    int y;                  /**< The y-coordinate of the menu. */
    int width;              /**< The width of the menu. */
@@ -98,6 +102,7 @@ typedef struct Menu {
    int parentOffset;       /**< y-offset of this menu wrt the parent. */
    int textOffset;         /**< x-offset of text in the menu. */
    int *offsets;           /**< y-offsets of menu items. */
+   struct MenuItem **itemArray; /**< Menu items by index. */
    struct Menu *parent;    /**< The parent menu (or NULL). */
    const struct ScreenType *screen;
    int mousex, mousey;
@@ -126,6 +131,20 @@ void InitializeMenu(Menu *menu);
 char ShowMenu(Menu *menu, RunMenuCommandType runner,
               int x, int y, char keyboard);
 
+/** Open the submenu of a menu item if the item is selected.
+ * This is used for submenus attached while the menu is shown.
+ * @param item The menu item.
+ */
+void OpenSelectedSubmenu(struct MenuItem *item);
+
+/** Release the rendered pixmaps of a menu and its submenus.
+ * Menus are rendered the first time they are shown and the pixmaps
+ * are kept until the menu is destroyed. This must be called before
+ * the X connection is closed for menus that are destroyed later.
+ * @param menu The menu.
+ */
+void ReleaseMenuPixmaps(Menu *menu);
+
 /** Destroy a menu structure.
  * @param menu The menu to destroy.
  */
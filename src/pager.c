@@ -21,6 +21,18 @@
 #include "popup.h"
 #include "font.h"
 #include "settings.h"
+#include "misc.h"
+#include "thumbnail.h"
+#include "error.h"
+
+/** State of a desktop on a pager. */
+typedef struct PagerDesktop {
+   Pixmap backgrounds[2];     /**< Background and label (index is active). */
+   unsigned long signature;   /**< Hash of the clients drawn. */
+   char active;               /**< Set if drawn as the current desktop. */
+   char valid;                /**< Set if the buffer is up to date. */
+   char damaged;              /**< Set if the tray is not up to date. */
+} PagerDesktop;
 
 /** Structure to represent a pager tray component. */
 typedef struct PagerType {
@@ -32,11 +44,11 @@ typedef struct PagerType {
    int scalex;             /**< Horizontal scale factor (fixed point). */
    int scaley;             /**< Vertical scale factor (fixed point). */
    char labeled;           /**< Set to label the pager. */
+   char thumbnails;        /**< Set to show window thumbnails. */
 
    Pixmap buffer;          /**< Buffer for rendering the pager. */
-
-   TimeType mouseTime;     /**< Timestamp of last mouse movement. */
-   int mousex, mousey;     /**< Coordinates of last mouse location. */
+   PagerDesktop *desktops; /**< State of each desktop in the buffer. */
+   char redraw;            /**< Set to redraw the whole buffer. */
 
    struct PagerType *next; /**< Next pager in the list. */
 
@@ -65,12 +77,20 @@ static void StopPagerMove(ClientNode *np,
 
 static void PagerMoveController(int wasDestroyed);
 
-static void DrawPager(const PagerType *pp);
+static void DrawPager(PagerType *pp);
+
+static void DrawPagerBackground(PagerType *pp, int desktop);
 
 static void DrawPagerClient(const PagerType *pp, const ClientNode *np);
 
-static void SignalPager(const TimeType *now, int x, int y, Window w,
-                        void *data);
+static int GetPagerClientArea(const PagerType *pp, const ClientNode *np,
+                              int *x, int *y, int *width, int *height);
+
+static ColorType GetPagerClientColor(const ClientNode *np);
+
+static void ClearPagerDesktops(PagerType *pp);
+
+static void ShowPagerPopup(void *data, int x, int y);
 
 
 /** Shutdown the pager. */
@@ -79,6 +99,11 @@ void ShutdownPager(void)
    PagerType *pp;
    for(pp = pagers; pp; pp = pp->next) {
       JXFreePixmap(display, pp->buffer);
+      if(pp->desktops) {
+         ClearPagerDesktops(pp);
+         Release(pp->desktops);
+         pp->desktops = NULL;
+      }
    }
 }
 
@@ -87,7 +112,6 @@ void DestroyPager(void)
 {
    PagerType *pp;
    while(pagers) {
-      UnregisterCallback(SignalPager, pagers);
       pp = pagers->next;
       Release(pagers);
       pagers = pp;
@@ -105,11 +129,9 @@ TrayComponentType *CreatePager(char labeled)
    pp->next = pagers;
    pagers = pp;
    pp->labeled = labeled;
-   pp->mousex = -settings.doubleClickDelta;
-   pp->mousey = -settings.doubleClickDelta;
-   pp->mouseTime.seconds = 0;
-   pp->mouseTime.ms = 0;
+   pp->thumbnails = 0;
    pp->buffer = None;
+   pp->desktops = NULL;
 
    cp = CreateTrayComponent();
    cp->object = pp;
@@ -119,8 +141,6 @@ TrayComponentType *CreatePager(char labeled)
    cp->ProcessButtonPress = ProcessPagerButtonEvent;
    cp->ProcessMotionEvent = ProcessPagerMotionEvent;
 
-   RegisterCallback(settings.popupDelay / 2, SignalPager, pp);
-
    return cp;
 }
 
@@ -143,6 +163,10 @@ void Create(TrayComponentType *cp)
                                cp->height, rootDepth);
    pp->buffer = cp->pixmap;
 
+   pp->desktops = Allocate(settings.desktopCount * sizeof(PagerDesktop));
+   memset(pp->desktops, 0, settings.desktopCount * sizeof(PagerDesktop));
+   pp->redraw = 1;
+
 }
 
 /** Set the size of a pager tray component. */
@@ -182,12 +206,17 @@ void SetSize(TrayComponentType *cp, int width, int height)
       pp->buffer = JXCreatePixmap(display, rootWindow, cp->width,
                                   cp->height, rootDepth);
       cp->pixmap = pp->buffer;
-      DrawPager(pp);
    }
 
    pp->scalex = ((pp->deskWidth - 2) << 16) / rootWidth;
    pp->scaley = ((pp->deskHeight - 2) << 16) / rootHeight;
 
+   if(pp->desktops) {
+      ClearPagerDesktops(pp);
+      pp->redraw = 1;
+      DrawPager(pp);
+   }
+
 }
 
 /** Get the desktop for a pager given a set of coordinates. */
@@ -244,12 +273,8 @@ void ProcessPagerButtonEvent(TrayComponentType *cp, int x, int y, int mask)
 /** Process a motion event on a pager tray component. */
 void ProcessPagerMotionEvent(TrayComponentType *cp, int x, int y, int mask)
 {
-
-   PagerType *pp = (PagerType*)cp->object;
-
-   pp->mousex = cp->screenx + x;
-   pp->mousey = cp->screeny + y;
-   GetCurrentTime(&pp->mouseTime);
+   UpdatePopupHover(ShowPagerPopup, cp->object, cp->tray->window,
+                    cp->screenx + x, cp->screeny + y);
 }
 
 /** Start a pager move operation. */
@@ -281,49 +306,9 @@ void StartPagerMove(TrayComponentType *cp, int x, int y)
    for(layer = LAST_LAYER; layer >= FIRST_LAYER; layer--) {
       for(np = nodes[layer]; np; np = np->next) {
 
-         /* Skip this client if it isn't mapped. */
-         if(!(np->state.status & STAT_MAPPED)) {
-            continue;
-         }
-         if(np->state.status & STAT_NOPAGER) {
-            continue;
-         }
-
          /* Skip this client if it isn't on the selected desktop. */
-         if(np->state.status & STAT_STICKY) {
-            if(currentDesktop != desktop) {
-               continue;
-            }
-         } else {
-            if(np->state.desktop != desktop) {
-               continue;
-            }
-         }
-
-         /* Get the offset and size of the client on the pager. */
-         cx = 1 + ((np->x * pp->scalex) >> 16);
-         cy = 1 + ((np->y * pp->scaley) >> 16);
-         cwidth = (np->width * pp->scalex) >> 16;
-         cheight = (np->height * pp->scaley) >> 16;
-
-         /* Normalize the offset and size. */
-         if(cx + cwidth > pp->deskWidth) {
-            cwidth = pp->deskWidth - cx;
-         }
-         if(cy + cheight > pp->deskHeight) {
-            cheight = pp->deskHeight - cy;
-         }
-         if(cx < 0) {
-            cwidth += cx;
-            cx = 0;
-         }
-         if(cy < 0) {
-            cheight += cy;
-            cy = 0;
-         }
-
-         /* Skip the client if we are no longer in bounds. */
-         if(cwidth <= 0 || cheight <= 0) {
+         if(GetPagerClientArea(pp, np, &cx, &cy, &cwidth, &cheight)
+            != desktop) {
             continue;
          }
 
@@ -497,18 +482,21 @@ void PagerMoveController(int wasDestroyed)
 
 }
 
-/** Draw a pager. */
-void DrawPager(const PagerType *pp)
+/** Draw a pager.
+ * Only desktops whose clients changed since the last call are drawn
+ * unless the whole pager needs to be redrawn.
+ */
+void DrawPager(PagerType *pp)
 {
    ClientNode *np;
    Pixmap buffer;
+   unsigned long *signatures;
    int width, height;
    int deskWidth, deskHeight;
-   unsigned int x;
-   const char *name;
-   int xc, yc;
-   int textWidth, textHeight;
-   int dx, dy;
+   int x, y, cwidth, cheight;
+   int desktop;
+   unsigned int i;
+   char changed;
 
    buffer = pp->cp->pixmap;
    width = pp->cp->width;
@@ -516,57 +504,155 @@ void DrawPager(const PagerType *pp)
    deskWidth = pp->deskWidth;
    deskHeight = pp->deskHeight;
 
-   /* Draw the background. */
-   JXSetForeground(display, rootGC, colors[COLOR_PAGER_BG]);
-   JXFillRectangle(display, buffer, rootGC, 0, 0, width, height);
-
-   /* Highlight the current desktop. */
-   JXSetForeground(display, rootGC, colors[COLOR_PAGER_ACTIVE_BG]);
-   dx = currentDesktop % settings.desktopWidth;
-   dy = currentDesktop / settings.desktopWidth;
-   JXFillRectangle(display, buffer, rootGC,
-                   dx * (deskWidth + 1), dy * (deskHeight + 1),
-                   deskWidth, deskHeight);
-
-   /* Draw the labels. */
-   if(pp->labeled) {
-      textHeight = GetStringHeight(FONT_PAGER);
-      if(textHeight < deskHeight) {
-         for(x = 0; x < settings.desktopCount; x++) {
-            dx = x % settings.desktopWidth;
-            dy = x / settings.desktopWidth;
-            name = GetDesktopName(x);
-            textWidth = GetStringWidth(FONT_PAGER, name);
-            if(textWidth < deskWidth) {
-               xc = dx * (deskWidth + 1) + (deskWidth - textWidth) / 2;
-               yc = dy * (deskHeight + 1) + (deskHeight - textHeight) / 2;
-               RenderString(buffer, FONT_PAGER,
-                            COLOR_PAGER_TEXT, xc, yc, deskWidth, name);
-            }
+   if(pp->redraw) {
+      JXSetForeground(display, rootGC, colors[COLOR_PAGER_BG]);
+      JXFillRectangle(display, buffer, rootGC, 0, 0, width, height);
+      for(i = 0; i < settings.desktopCount; i++) {
+         pp->desktops[i].valid = 0;
+      }
+      pp->redraw = 0;
+   }
+
+   /* Hash what should be shown on each desktop. */
+   signatures = AllocateStack(settings.desktopCount * sizeof(unsigned long));
+   for(i = 0; i < settings.desktopCount; i++) {
+      signatures[i] = 5381;
+   }
+   for(i = FIRST_LAYER; i <= LAST_LAYER; i++) {
+      for(np = nodeTail[i]; np; np = np->prev) {
+         unsigned long hash;
+         desktop = GetPagerClientArea(pp, np, &x, &y, &cwidth, &cheight);
+         if(desktop < 0) {
+            continue;
          }
+         hash = signatures[desktop];
+         hash = (hash * 33) ^ (unsigned long)x;
+         hash = (hash * 33) ^ (unsigned long)y;
+         hash = (hash * 33) ^ (unsigned long)cwidth;
+         hash = (hash * 33) ^ (unsigned long)cheight;
+         hash = (hash * 33) ^ (unsigned long)GetPagerClientColor(np);
+         if(pp->thumbnails) {
+            hash = (hash * 33) ^ (unsigned long)GetThumbnailSerial(np);
+         }
+         signatures[desktop] = hash;
+      }
+   }
+
+   /* Draw the backgrounds of desktops that changed. */
+   changed = 0;
+   for(i = 0; i < settings.desktopCount; i++) {
+      PagerDesktop *dp = &pp->desktops[i];
+      const char active = i == currentDesktop;
+      if(dp->valid && dp->active == active
+         && dp->signature == signatures[i]) {
+         continue;
       }
+      dp->valid = 0;
+      dp->active = active;
+      dp->signature = signatures[i];
+      DrawPagerBackground(pp, i);
+      changed = 1;
+   }
+   ReleaseStack(signatures);
+   if(!changed) {
+      return;
    }
 
-   /* Draw the clients. */
-   for(x = FIRST_LAYER; x <= LAST_LAYER; x++) {
-      for(np = nodeTail[x]; np; np = np->prev) {
-         DrawPagerClient(pp, np);
+   /* Draw the clients on those desktops. */
+   for(i = FIRST_LAYER; i <= LAST_LAYER; i++) {
+      for(np = nodeTail[i]; np; np = np->prev) {
+         desktop = GetPagerClientArea(pp, np, &x, &y, &cwidth, &cheight);
+         if(desktop >= 0 && !pp->desktops[desktop].valid) {
+            DrawPagerClient(pp, np);
+         }
+      }
+   }
+   for(i = 0; i < settings.desktopCount; i++) {
+      if(!pp->desktops[i].valid) {
+         pp->desktops[i].valid = 1;
+         pp->desktops[i].damaged = 1;
       }
    }
 
-   /* Draw the desktop dividers. */
+   /* Draw the desktop dividers (clients may overlap them). */
    JXSetForeground(display, rootGC, colors[COLOR_PAGER_OUTLINE]);
-   for(x = 1; x < settings.desktopHeight; x++) {
+   for(i = 1; i < settings.desktopHeight; i++) {
       JXDrawLine(display, buffer, rootGC,
-                 0, (deskHeight + 1) * x - 1,
-                 width, (deskHeight + 1) * x - 1);
+                 0, (deskHeight + 1) * i - 1,
+                 width, (deskHeight + 1) * i - 1);
    }
-   for(x = 1; x < settings.desktopWidth; x++) {
+   for(i = 1; i < settings.desktopWidth; i++) {
       JXDrawLine(display, buffer, rootGC,
-                 (deskWidth + 1) * x - 1, 0,
-                 (deskWidth + 1) * x - 1, height);
+                 (deskWidth + 1) * i - 1, 0,
+                 (deskWidth + 1) * i - 1, height);
+   }
+
+}
+
+/** Draw the background and label of a desktop on a pager.
+ * The result is cached for each desktop and highlight.
+ */
+void DrawPagerBackground(PagerType *pp, int desktop)
+{
+   PagerDesktop *dp = &pp->desktops[desktop];
+   const int deskWidth = pp->deskWidth;
+   const int deskHeight = pp->deskHeight;
+   Pixmap background = dp->backgrounds[(int)dp->active];
+
+   if(background == None) {
+
+      const char *name;
+      int textWidth, textHeight;
+
+      background = JXCreatePixmap(display, rootWindow,
+                                  deskWidth, deskHeight, rootDepth);
+      dp->backgrounds[(int)dp->active] = background;
+
+      /* Draw the background (highlight the current desktop). */
+      JXSetForeground(display, rootGC, colors[dp->active
+                      ? COLOR_PAGER_ACTIVE_BG : COLOR_PAGER_BG]);
+      JXFillRectangle(display, background, rootGC,
+                      0, 0, deskWidth, deskHeight);
+
+      /* Draw the label. */
+      if(pp->labeled) {
+         textHeight = GetStringHeight(FONT_PAGER);
+         if(textHeight < deskHeight) {
+            name = GetDesktopName(desktop);
+            textWidth = GetStringWidth(FONT_PAGER, name);
+            if(textWidth < deskWidth) {
+               RenderString(background, FONT_PAGER, COLOR_PAGER_TEXT,
+                            (deskWidth - textWidth) / 2,
+                            (deskHeight - textHeight) / 2,
+                            deskWidth, name);
+            }
+         }
+      }
+
    }
 
+   JXCopyArea(display, background, pp->cp->pixmap, rootGC,
+              0, 0, deskWidth, deskHeight,
+              (desktop % settings.desktopWidth) * (deskWidth + 1),
+              (desktop / settings.desktopWidth) * (deskHeight + 1));
+}
+
+/** Release the cached desktop backgrounds of a pager. */
+void ClearPagerDesktops(PagerType *pp)
+{
+   unsigned int i;
+   for(i = 0; i < settings.desktopCount; i++) {
+      PagerDesktop *dp = &pp->desktops[i];
+      if(dp->backgrounds[0] != None) {
+         JXFreePixmap(display, dp->backgrounds[0]);
+         dp->backgrounds[0] = None;
+      }
+      if(dp->backgrounds[1] != None) {
+         JXFreePixmap(display, dp->backgrounds[1]);
+         dp->backgrounds[1] = None;
+      }
+      dp->valid = 0;
+   }
 }
 
 /** Update the pager. */
@@ -581,94 +667,156 @@ void UpdatePager(void)
 
    for(pp = pagers; pp; pp = pp->next) {
 
+      const int width = pp->cp->width;
+      const int height = pp->cp->height;
+      unsigned int i;
+
+      if(JUNLIKELY(!pp->desktops)) {
+         continue;
+      }
+
       /* Draw the pager. */
       DrawPager(pp);
 
-      /* Tell the tray to redraw. */
-      UpdateSpecificTray(pp->cp->tray, pp->cp);
+      /* Copy changed desktops (and their dividers) to the tray. */
+      for(i = 0; i < settings.desktopCount; i++) {
+         if(pp->desktops[i].damaged) {
+            const int x = (i % settings.desktopWidth) * (pp->deskWidth + 1);
+            const int y = (i / settings.desktopWidth) * (pp->deskHeight + 1);
+            UpdateSpecificTrayArea(pp->cp->tray, pp->cp, x, y,
+                                   Min(pp->deskWidth + 1, width - x),
+                                   Min(pp->deskHeight + 1, height - y));
+            pp->desktops[i].damaged = 0;
+         }
+      }
 
    }
 
 }
 
-/** Signal pagers (for popups). */
-void SignalPager(const TimeType *now, int x, int y, Window w, void *data)
+/** Show window thumbnails on a pager. */
+void SetPagerThumbnails(TrayComponentType *cp, const char *value)
 {
-   PagerType *pp = (PagerType*)data;
-   if(pp->cp->tray->window == w &&
-      abs(pp->mousex - x) < settings.doubleClickDelta &&
-      abs(pp->mousey - y) < settings.doubleClickDelta) {
-      if(GetTimeDifference(now, &pp->mouseTime) >= settings.popupDelay) {
-         const int desktop = GetPagerDesktop(pp, x - pp->cp->screenx,
-                                                 y - pp->cp->screeny);
-         if(desktop >= 0 && desktop < settings.desktopCount) {
-            const char *desktopName = GetDesktopName(desktop);
-            if(desktopName) {
-               ShowPopup(x, y, desktopName, POPUP_PAGER);
-            }
-         }
+   PagerType *pp = (PagerType*)cp->object;
+   int rate;
+
+   Assert(cp);
+   Assert(value);
+
+   rate = atoi(value);
+   if(JUNLIKELY(rate < 0)) {
+      Warning(_("invalid thumbnail rate for Pager: %s"), value);
+      return;
+   }
+   pp->thumbnails = rate > 0;
+   if(rate > 0) {
+      RequireThumbnails(rate);
+   }
+}
 
+/** Show the popup for a desktop on a pager. */
+void ShowPagerPopup(void *data, int x, int y)
+{
+   PagerType *pp = (PagerType*)data;
+   const int desktop = GetPagerDesktop(pp, x - pp->cp->screenx,
+                                       y - pp->cp->screeny);
+   if(desktop >= 0 && desktop < settings.desktopCount) {
+      const char *desktopName = GetDesktopName(desktop);
+      if(desktopName) {
+         ShowPopup(x, y, desktopName, POPUP_PAGER);
       }
    }
 }
 
-/** Draw a client on the pager. */
-void DrawPagerClient(const PagerType *pp, const ClientNode *np)
+/** Get the area of a client on the pager.
+ * The area is relative to the desktop on the pager.
+ * @return The desktop showing the client (-1 if not shown).
+ */
+int GetPagerClientArea(const PagerType *pp, const ClientNode *np,
+                       int *x, int *y, int *width, int *height)
 {
 
-   int x, y;
-   int width, height;
-   int offx, offy;
+   int desktop;
 
-   /* Don't draw the client if it isn't mapped. */
+   /* Don't show the client if it isn't mapped. */
    if(!(np->state.status & STAT_MAPPED)) {
-      return;
+      return -1;
    }
    if(np->state.status & STAT_NOPAGER) {
-      return;
+      return -1;
    }
 
    /* Determine the desktop for the client. */
    if(np->state.status & STAT_STICKY) {
-      offx = currentDesktop % settings.desktopWidth;
-      offy = currentDesktop / settings.desktopWidth;
+      desktop = currentDesktop;
    } else {
-      offx = np->state.desktop % settings.desktopWidth;
-      offy = np->state.desktop / settings.desktopWidth;
+      desktop = np->state.desktop;
+   }
+   if(JUNLIKELY(desktop >= settings.desktopCount)) {
+      return -1;
    }
-   offx *= pp->deskWidth + 1;
-   offy *= pp->deskHeight + 1;
 
    /* Determine the location and size of the client on the pager. */
-   x = 1 + ((np->x * pp->scalex) >> 16);
-   y = 1 + ((np->y * pp->scaley) >> 16);
-   width = (np->width * pp->scalex) >> 16;
-   height = (np->height * pp->scaley) >> 16;
+   *x = 1 + ((np->x * pp->scalex) >> 16);
+   *y = 1 + ((np->y * pp->scaley) >> 16);
+   *width = (np->width * pp->scalex) >> 16;
+   *height = (np->height * pp->scaley) >> 16;
 
    /* Normalize the size and offset. */
-   if(x + width > pp->deskWidth) {
-      width = pp->deskWidth - x;
+   if(*x + *width > pp->deskWidth) {
+      *width = pp->deskWidth - *x;
+   }
+   if(*y + *height > pp->deskHeight) {
+      *height = pp->deskHeight - *y;
    }
-   if(y + height > pp->deskHeight) {
-      height = pp->deskHeight - y;
+   if(*x < 0) {
+      *width += *x;
+      *x = 0;
    }
-   if(x < 0) {
-      width += x;
-      x = 0;
+   if(*y < 0) {
+      *height += *y;
+      *y = 0;
+   }
+
+   /* Nothing to show if the client is out of bounds. */
+   if(*width <= 0 || *height <= 0) {
+      return -1;
    }
-   if(y < 0) {
-      height += y;
-      y = 0;
+
+   return desktop;
+
+}
+
+/** Get the color used to fill a client on the pager. */
+ColorType GetPagerClientColor(const ClientNode *np)
+{
+   if((np->state.status & STAT_ACTIVE)
+      && (np->state.desktop == currentDesktop
+      || (np->state.status & STAT_STICKY))) {
+      return COLOR_PAGER_ACTIVE_FG;
+   } else if(np->state.status & STAT_FLASH) {
+      return COLOR_PAGER_ACTIVE_FG;
+   } else {
+      return COLOR_PAGER_FG;
    }
+}
+
+/** Draw a client on the pager. */
+void DrawPagerClient(const PagerType *pp, const ClientNode *np)
+{
 
-   /* Return if there's nothing to do. */
-   if(width <= 0 || height <= 0) {
+   int x, y;
+   int width, height;
+   int desktop;
+
+   desktop = GetPagerClientArea(pp, np, &x, &y, &width, &height);
+   if(desktop < 0) {
       return;
    }
 
    /* Move to the correct desktop on the pager. */
-   x += offx;
-   y += offy;
+   x += (desktop % settings.desktopWidth) * (pp->deskWidth + 1);
+   y += (desktop / settings.desktopWidth) * (pp->deskHeight + 1);
 
    /* Draw the client outline. */
    JXSetForeground(display, rootGC, colors[COLOR_PAGER_OUTLINE]);
@@ -676,20 +824,13 @@ void DrawPagerClient(const PagerType *pp, const ClientNode *np)
 
    /* Fill the client if there's room. */
    if(width > 1 && height > 1) {
-      ColorType fillColor;
-      if((np->state.status & STAT_ACTIVE)
-         && (np->state.desktop == currentDesktop
-         || (np->state.status & STAT_STICKY))) {
-         fillColor = COLOR_PAGER_ACTIVE_FG;
-      } else if(np->state.status & STAT_FLASH) {
-         fillColor = COLOR_PAGER_ACTIVE_FG;
-      } else {
-         fillColor = COLOR_PAGER_FG;
+      if(pp->thumbnails && PutThumbnail(np, pp->cp->pixmap, x + 1, y + 1,
+                                        width - 1, height - 1)) {
+         return;
       }
-      JXSetForeground(display, rootGC, colors[fillColor]);
+      JXSetForeground(display, rootGC, colors[GetPagerClientColor(np)]);
       JXFillRectangle(display, pp->cp->pixmap, rootGC, x + 1, y + 1,
                       width - 1, height - 1);
    }
 
 }
-
@@ -25,6 +25,12 @@ void DestroyPager(void);
  */
 struct TrayComponentType *CreatePager(char labeled);
 
+/** Show live window thumbnails on a pager.
+ * @param cp The pager.
+ * @param value The maximum number of thumbnail refreshes per second.
+ */
+void SetPagerThumbnails(struct TrayComponentType *cp, const char *value);
+
 /** Update pagers. */
 void UpdatePager(void);
 
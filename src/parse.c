@@ -32,6 +32,7 @@
 #include "spacer.h"
 #include "desktop.h"
 #include "border.h"
+#include "dynamic.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -135,6 +136,9 @@ static const char *X_ATTRIBUTE = "x";
 static const char *Y_ATTRIBUTE = "y";
 static const char *WIDTH_ATTRIBUTE = "width";
 static const char *HEIGHT_ATTRIBUTE = "height";
+static const char *TTL_ATTRIBUTE = "ttl";
+static const char *DEPENDS_ATTRIBUTE = "depends";
+static const char *THUMBNAILS_ATTRIBUTE = "thumbnails";
 
 static const char *FALSE_VALUE = "false";
 static const char *TRUE_VALUE = "true";
@@ -531,6 +535,7 @@ MenuItem *ParseMenuItem(const TokenNode *start, Menu *menu, MenuItem *last)
 
          value = FindAttribute(start->attributes, ICON_ATTRIBUTE);
          last->iconName = CopyString(value);
+         PreloadIcon(value);
 
          value = FindAttribute(start->attributes, TOOLTIP_ATTRIBUTE);
          last->tooltip = CopyString(value);
@@ -545,6 +550,12 @@ MenuItem *ParseMenuItem(const TokenNode *start, Menu *menu, MenuItem *last)
             last->action.value = menu->itemHeight;
          }
 
+         value = FindAttribute(start->attributes, TTL_ATTRIBUTE);
+         last->action.context = CreateDynamicMenu(
+            start->value, last->action.value,
+            value ? ParseUnsigned(start, value) : 0,
+            FindAttribute(start->attributes, DEPENDS_ATTRIBUTE));
+
          break;
       case TOK_MENU:
 
@@ -559,6 +570,7 @@ MenuItem *ParseMenuItem(const TokenNode *start, Menu *menu, MenuItem *last)
 
          value = FindAttribute(start->attributes, ICON_ATTRIBUTE);
          last->iconName = CopyString(value);
+         PreloadIcon(value);
 
          value = FindAttribute(start->attributes, TOOLTIP_ATTRIBUTE);
          last->tooltip = CopyString(value);
@@ -607,6 +619,7 @@ MenuItem *ParseMenuItem(const TokenNode *start, Menu *menu, MenuItem *last)
 
          value = FindAttribute(start->attributes, ICON_ATTRIBUTE);
          last->iconName = CopyString(value);
+         PreloadIcon(value);
 
          last->action.type = MA_EXECUTE;
          last->action.str = CopyString(start->value);
@@ -651,6 +664,7 @@ MenuItem *ParseMenuItem(const TokenNode *start, Menu *menu, MenuItem *last)
 
          value = FindAttribute(start->attributes, ICON_ATTRIBUTE);
          last->iconName = CopyString(value);
+         PreloadIcon(value);
 
          switch(start->type) {
          case TOK_DESKTOPS:
@@ -706,6 +720,7 @@ MenuItem *ParseMenuItem(const TokenNode *start, Menu *menu, MenuItem *last)
 
          value = FindAttribute(start->attributes, ICON_ATTRIBUTE);
          last->iconName = CopyString(value);
+         PreloadIcon(value);
 
          last->action.type = MA_EXIT;
          last->action.str = CopyString(start->value);
@@ -735,6 +750,7 @@ MenuItem *ParseMenuItem(const TokenNode *start, Menu *menu, MenuItem *last)
 
          value = FindAttribute(start->attributes, ICON_ATTRIBUTE);
          last->iconName = CopyString(value);
+         PreloadIcon(value);
 
          last->action.type = MA_RESTART;
 
@@ -795,6 +811,20 @@ Menu *ParseDynamicMenu(const char *command)
    return menu;
 }
 
+/** Parse the output of a program generating a dynamic menu. */
+Menu *ParseDynamicMenuOutput(const char *command, const char *output)
+{
+   Menu *menu = NULL;
+   TokenNode *start = Tokenize(output, command);
+   if(JLIKELY(start && start->type == TOK_JWM)) {
+      menu = ParseMenu(start);
+   } else {
+      ParseError(NULL, _("invalid include: %s"), command);
+   }
+   ReleaseTokens(start);
+   return menu;
+}
+
 /** Parse a key binding. */
 void ParseKey(const TokenNode *tp) {
 
@@ -1239,6 +1269,11 @@ void ParsePager(const TokenNode *tp, TrayType *tray)
    cp = CreatePager(labeled);
    AddTrayComponent(tray, cp);
 
+   temp = FindAttribute(tp->attributes, THUMBNAILS_ATTRIBUTE);
+   if(temp) {
+      SetPagerThumbnails(cp, temp);
+   }
+
 }
 
 /** Parse a task list tray component. */
@@ -1720,6 +1755,7 @@ void ParseGroupOption(const TokenNode *tp, struct GroupType *group,
       AddGroupOptionUnsigned(group, OPTION_DESKTOP, desktop);
    } else if(!strncmp(option, "icon:", 5)) {
       AddGroupOptionString(group, OPTION_ICON, option + 5);
+      PreloadIcon(option + 5);
    } else if(!strncmp(option, "opacity:", 8)) {
       const unsigned int opacity = ParseOpacity(tp, option + 8);
       AddGroupOptionUnsigned(group, OPTION_OPACITY, opacity);
@@ -23,5 +23,12 @@ void ParseConfig(const char *fileName);
  */
 struct Menu *ParseDynamicMenu(const char *command);
 
+/** Parse the output of a program generating a dynamic menu.
+ * @param command The command that generated the menu.
+ * @param output The output of the program.
+ * @return The menu (NULL if the output is not valid).
+ */
+struct Menu *ParseDynamicMenuOutput(const char *command, const char *output);
+
 #endif /* PARSE_H */
 
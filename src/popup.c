@@ -32,17 +32,29 @@ typedef struct PopupType {
    Pixmap pmap;
 } PopupType;
 
+/** The item under the mouse that may need a popup. */
+typedef struct PopupHoverType {
+   PopupHoverCallback callback;  /**< Function to show the popup. */
+   void *data;                   /**< Data for the callback. */
+   int x, y;                     /**< Mouse location. */
+   Window w;                     /**< Window under the mouse. */
+} PopupHoverType;
+
 static PopupType popup;
+static PopupHoverType hover;
 
 static void MeasurePopupText();
 static void SignalPopup(const TimeType *now, int x, int y, Window w,
                         void *data);
+static void SignalPopupHover(const TimeType *now, int x, int y, Window w,
+                             void *data);
 
 /** Startup popups. */
 void StartupPopup(void)
 {
    popup.text = NULL;
    popup.window = None;
+   hover.callback = NULL;
    RegisterCallback(100, SignalPopup, NULL);
 }
 
@@ -50,6 +62,7 @@ void StartupPopup(void)
 void ShutdownPopup(void)
 {
    UnregisterCallback(SignalPopup, NULL);
+   CancelPopupHover();
    if(popup.text) {
       Release(popup.text);
       Release(popup.lines);
@@ -203,6 +216,49 @@ void ShowPopup(int x, int y, const char *text,
 
 }
 
+/** Note that the mouse moved over an item that has a popup. */
+void UpdatePopupHover(PopupHoverCallback callback, void *data,
+                      Window w, int x, int y)
+{
+   /* Small movements do not restart the delay. */
+   if(   hover.callback == callback && hover.data == data && hover.w == w
+      && abs(hover.x - x) < settings.doubleClickDelta
+      && abs(hover.y - y) < settings.doubleClickDelta) {
+      return;
+   }
+   hover.callback = callback;
+   hover.data = data;
+   hover.x = x;
+   hover.y = y;
+   hover.w = w;
+   RegisterTimeout(settings.popupDelay, SignalPopupHover, &hover);
+}
+
+/** Stop waiting to show a popup. */
+void CancelPopupHover(void)
+{
+   if(hover.callback) {
+      CancelTimeout(SignalPopupHover, &hover);
+      hover.callback = NULL;
+   }
+}
+
+/** Show the popup for the item under the mouse if the mouse settled. */
+void SignalPopupHover(const TimeType *now, int x, int y, Window w, void *data)
+{
+   if(   hover.callback && hover.w == w
+      && abs(hover.x - x) < settings.doubleClickDelta
+      && abs(hover.y - y) < settings.doubleClickDelta) {
+      (hover.callback)(hover.data, x, y);
+
+      /* Keep the popup up to date while the mouse stays here. */
+      RegisterTimeout(Max(100, settings.popupDelay / 2),
+                      SignalPopupHover, &hover);
+   } else {
+      hover.callback = NULL;
+   }
+}
+
 /** Signal popup (this is used to hide popups after awhile). */
 void SignalPopup(const TimeType *now, int x, int y, Window w, void *data)
 {
@@ -19,6 +19,28 @@ void ShutdownPopup(void);
 #define DestroyPopup()     (void)(0)
 /*@}*/
 
+/** Function to show the popup for a location.
+ * @param data The data passed to UpdatePopupHover.
+ * @param x The x-coordinate of the mouse on the root window.
+ * @param y The y-coordinate of the mouse on the root window.
+ */
+typedef void (*PopupHoverCallback)(void *data, int x, int y);
+
+/** Note that the mouse moved over an item that has a popup.
+ * The callback is run once the mouse stays near this location for the
+ * popup delay, and then periodically until the mouse moves away.
+ * @param callback The function to show the popup.
+ * @param data Data to pass to the callback.
+ * @param w The top-level window under the mouse.
+ * @param x The x-coordinate of the mouse on the root window.
+ * @param y The y-coordinate of the mouse on the root window.
+ */
+void UpdatePopupHover(PopupHoverCallback callback, void *data,
+                      Window w, int x, int y);
+
+/** Stop waiting to show a popup (for example when the mouse leaves). */
+void CancelPopupHover(void);
+
 /** Show a popup window.
  * @param x The x coordinate of the left edge of the popup window.
  * @param y The y coordinate of the bottom edge of the popup window.
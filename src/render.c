@@ -14,6 +14,7 @@
 #include "main.h"
 #include "color.h"
 #include "misc.h"
+#include "upload.h"
 
 /** Draw a scaled icon. */
 void PutScaledRenderIcon(const IconNode *icon,
@@ -112,13 +113,8 @@ ScaledIconNode *CreateScaledRenderIcon(ImageNode *image, long fg)
    maskGC = JXCreateGC(display, mask, 0, NULL);
    pmap = JXCreatePixmap(display, rootWindow, width, height, rootDepth);
 
-   destImage = JXCreateImage(display, rootVisual, rootDepth,
-                             ZPixmap, 0, NULL, width, height, 8, 0);
-   destImage->data = Allocate(sizeof(unsigned long) * width * height);
-
-   destMask = JXCreateImage(display, rootVisual, 8, ZPixmap,
-                            0, NULL, width, height, 8, 0);
-   destMask->data = Allocate(width * height);
+   destImage = CreateUploadImage(rootDepth, width, height);
+   destMask = CreateUploadImage(8, width, height);
 
    if(image->bitmap) {
       perLine = (image->width >> 3) + ((image->width & 7) ? 1 : 0);
@@ -164,16 +160,12 @@ ScaledIconNode *CreateScaledRenderIcon(ImageNode *image, long fg)
    }
 
    /* Render the image data to the image pixmap. */
-   JXPutImage(display, pmap, rootGC, destImage, 0, 0, 0, 0, width, height);
-   Release(destImage->data);
-   destImage->data = NULL;
-   JXDestroyImage(destImage);
+   PutUploadImage(pmap, rootGC, destImage);
 
    /* Render the alpha data to the mask pixmap. */
-   JXPutImage(display, mask, maskGC, destMask, 0, 0, 0, 0, width, height);
-   Release(destMask->data);
-   destMask->data = NULL;
-   JXDestroyImage(destMask);
+   PutUploadImage(mask, maskGC, destMask);
+   DestroyUploadImage(destImage);
+   DestroyUploadImage(destMask);
    JXFreeGC(display, maskGC);
 
    /* Create the alpha picture. */
@@ -62,6 +62,24 @@ void StartupRootMenu(void)
 
 }
 
+/** Shutdown root menus. */
+void ShutdownRootMenu(void)
+{
+   unsigned int x, y;
+   for(x = 0; x < ROOT_MENU_COUNT; x++) {
+      if(rootMenu[x]) {
+         for(y = 0; y < x; y++) {
+            if(rootMenu[y] == rootMenu[x]) {
+               break;
+            }
+         }
+         if(y == x) {
+            ReleaseMenuPixmaps(rootMenu[x]);
+         }
+      }
+   }
+}
+
 /** Destroy root menu data. */
 void DestroyRootMenu(void)
 {
@@ -135,6 +135,7 @@ void DrawMoveResizeWindow(const ClientNode *np, StatusWindowType type)
 void DestroyMoveResizeWindow(void)
 {
    if(statusWindow != None) {
+      ReleaseTextDrawable(statusWindow);
       JXDestroyWindow(display, statusWindow);
       statusWindow = None;
    }
@@ -27,6 +27,15 @@
 #include "misc.h"
 #include "desktop.h"
 
+/** What was last drawn in a task bar cell. */
+typedef struct TaskCell {
+   struct TaskEntry *entry;         /**< The entry shown. */
+   const IconNode *icon;            /**< The icon shown. */
+   char *text;                      /**< The text shown (or NULL). */
+   ButtonType type;                 /**< The button type. */
+   char valid;                      /**< Set if the cell is up to date. */
+} TaskCell;
+
 typedef struct TaskBarType {
 
    TrayComponentType *cp;
@@ -41,8 +50,11 @@ typedef struct TaskBarType {
 
    Pixmap buffer;
 
-   TimeType mouseTime;
-   int mousex, mousey;
+   TaskCell *cells;        /**< Contents of each cell in buffer. */
+   unsigned cellCount;     /**< Number of cells in buffer. */
+   int cellWidth;          /**< Item width when cells were drawn. */
+   int cellHeight;         /**< Item height when cells were drawn. */
+   char redraw;            /**< Set to redraw every cell. */
 
 } TaskBarType;
 
@@ -54,19 +66,34 @@ typedef struct ClientEntry {
 
 typedef struct TaskEntry {
    ClientEntry *clients;
-   struct TaskEntry *next;
-   struct TaskEntry *prev;
+   struct TaskEntry *hashNext;   /**< Next group in the class hash. */
 } TaskEntry;
 
+/** Number of buckets in the class name hash. */
+#define CLASS_HASH_SIZE 64
+
 static TaskBarType *bars;
-static TaskEntry *taskEntries;
-static TaskEntry *taskEntriesTail;
+
+/** Task entries in task bar order. */
+static TaskEntry **taskEntries;
+static unsigned taskEntryCount;
+static unsigned taskEntryCapacity;
+
+/** Groups by class name (only used when grouping tasks). */
+static TaskEntry *classHash[CLASS_HASH_SIZE];
 
 static void ComputeItemSize(TaskBarType *tp);
 static char ShouldShowEntry(const TaskEntry *tp);
 static char ShouldFocusEntry(const TaskEntry *tp);
 static TaskEntry *GetEntry(TaskBarType *bar, int x, int y);
-static void Render(const TaskBarType *bp);
+static unsigned GetClassHash(const char *className);
+static TaskEntry *FindGroup(const char *className);
+static int FindClientEntry(const ClientNode *np, ClientEntry **result);
+static int FindActiveEntry(void);
+static void FocusNextEntry(int direction);
+static void Render(TaskBarType *bp);
+static void RenderCells(TaskBarType *bp, char full);
+static void ClearCells(TaskBarType *bp);
 static void ShowClientList(TaskBarType *bar, TaskEntry *tp);
 static void RunTaskBarCommand(MenuAction *action, unsigned button);
 
@@ -79,15 +106,16 @@ static void MinimizeGroup(const TaskEntry *tp);
 static void FocusGroup(const TaskEntry *tp);
 static void ProcessTaskMotionEvent(TrayComponentType *cp,
                                    int x, int y, int mask);
-static void SignalTaskbar(const TimeType *now, int x, int y, Window w,
-                          void *data);
+static void ShowTaskPopup(void *data, int x, int y);
 
 /** Initialize task bar data. */
 void InitializeTaskBar(void)
 {
    bars = NULL;
    taskEntries = NULL;
-   taskEntriesTail = NULL;
+   taskEntryCount = 0;
+   taskEntryCapacity = 0;
+   memset(classHash, 0, sizeof(classHash));
 }
 
 /** Shutdown the task bar. */
@@ -105,10 +133,18 @@ void DestroyTaskBar(void)
    TaskBarType *bp;
    while(bars) {
       bp = bars->next;
-      UnregisterCallback(SignalTaskbar, bars);
+      ClearCells(bars);
+      if(bars->cells) {
+         Release(bars->cells);
+      }
       Release(bars);
       bars = bp;
    }
+   if(taskEntries) {
+      Release(taskEntries);
+      taskEntries = NULL;
+      taskEntryCapacity = 0;
+   }
 }
 
 /** Create a new task bar tray component. */
@@ -127,10 +163,11 @@ TrayComponentType *CreateTaskBar()
    tp->maxItemWidth = 0;
    tp->layout = LAYOUT_HORIZONTAL;
    tp->labeled = 1;
-   tp->mousex = -settings.doubleClickDelta;
-   tp->mousey = -settings.doubleClickDelta;
-   tp->mouseTime.seconds = 0;
-   tp->mouseTime.ms = 0;
+   tp->cells = NULL;
+   tp->cellCount = 0;
+   tp->cellWidth = 0;
+   tp->cellHeight = 0;
+   tp->redraw = 1;
 
    cp = CreateTrayComponent();
    cp->object = tp;
@@ -142,8 +179,6 @@ TrayComponentType *CreateTaskBar()
    cp->ProcessButtonPress = ProcessTaskButtonEvent;
    cp->ProcessMotionEvent = ProcessTaskMotionEvent;
 
-   RegisterCallback(settings.popupDelay / 2, SignalTaskbar, tp);
-
    return cp;
 
 }
@@ -170,6 +205,7 @@ void Create(TrayComponentType *cp)
    cp->pixmap = JXCreatePixmap(display, rootWindow, cp->width, cp->height,
                                rootDepth);
    tp->buffer = cp->pixmap;
+   tp->redraw = 1;
    ClearTrayDrawable(cp);
 }
 
@@ -183,6 +219,7 @@ void Resize(TrayComponentType *cp)
    cp->pixmap = JXCreatePixmap(display, rootWindow, cp->width, cp->height,
                                rootDepth);
    tp->buffer = cp->pixmap;
+   tp->redraw = 1;
    ClearTrayDrawable(cp);
 }
 
@@ -201,12 +238,12 @@ void ComputeItemSize(TaskBarType *tp)
 
    } else {
 
-      TaskEntry *ep;
       unsigned itemCount = 0;
+      unsigned i;
 
       tp->itemHeight = cp->height;
-      for(ep = taskEntries; ep; ep = ep->next) {
-         if(ShouldShowEntry(ep)) {
+      for(i = 0; i < taskEntryCount; i++) {
+         if(ShouldShowEntry(taskEntries[i])) {
             itemCount += 1;
          }
       }
@@ -419,10 +456,8 @@ void FocusGroup(const TaskEntry *tp)
 /** Process a task list motion event. */
 void ProcessTaskMotionEvent(TrayComponentType *cp, int x, int y, int mask)
 {
-   TaskBarType *bp = (TaskBarType*)cp->object;
-   bp->mousex = cp->screenx + x;
-   bp->mousey = cp->screeny + y;
-   GetCurrentTime(&bp->mouseTime);
+   UpdatePopupHover(ShowTaskPopup, cp->object, cp->tray->window,
+                    cp->screenx + x, cp->screeny + y);
 }
 
 /** Show the menu associated with a task list item. */
@@ -591,24 +626,28 @@ void AddClientToTaskBar(ClientNode *np)
    cp->client = np;
 
    if(np->className && settings.groupTasks) {
-      for(tp = taskEntries; tp; tp = tp->next) {
-         const char *className = tp->clients->client->className;
-         if(className && !strcmp(np->className, className)) {
-            break;
-         }
-      }
+      tp = FindGroup(np->className);
    }
    if(tp == NULL) {
       tp = Allocate(sizeof(TaskEntry));
       tp->clients = NULL;
-      tp->next = NULL;
-      tp->prev = taskEntriesTail;
-      if(taskEntriesTail) {
-         taskEntriesTail->next = tp;
-      } else {
-         taskEntries = tp;
+      tp->hashNext = NULL;
+      if(np->className && settings.groupTasks) {
+         const unsigned hash = GetClassHash(np->className);
+         tp->hashNext = classHash[hash];
+         classHash[hash] = tp;
+      }
+      if(taskEntryCount == taskEntryCapacity) {
+         taskEntryCapacity = Max(16, taskEntryCapacity * 2);
+         if(taskEntries) {
+            taskEntries = Reallocate(taskEntries,
+                                     taskEntryCapacity * sizeof(TaskEntry*));
+         } else {
+            taskEntries = Allocate(taskEntryCapacity * sizeof(TaskEntry*));
+         }
       }
-      taskEntriesTail = tp;
+      taskEntries[taskEntryCount] = tp;
+      taskEntryCount += 1;
    }
 
    cp->next = tp->clients;
@@ -618,6 +657,7 @@ void AddClientToTaskBar(ClientNode *np)
    cp->prev = NULL;
    tp->clients = cp;
 
+   RedrawTaskBars();
    RequireTaskUpdate();
    UpdateNetClientList();
 
@@ -627,38 +667,40 @@ void AddClientToTaskBar(ClientNode *np)
 void RemoveClientFromTaskBar(ClientNode *np)
 {
    TaskEntry *tp;
-   for(tp = taskEntries; tp; tp = tp->next) {
-      ClientEntry *cp;
-      for(cp = tp->clients; cp; cp = cp->next) {
-         if(cp->client == np) {
-            if(cp->prev) {
-               cp->prev->next = cp->next;
-            } else {
-               tp->clients = cp->next;
-            }
-            if(cp->next) {
-               cp->next->prev = cp->prev;
-            }
-            Release(cp);
-            if(!tp->clients) {
-               if(tp->prev) {
-                  tp->prev->next = tp->next;
-               } else {
-                  taskEntries = tp->next;
-               }
-               if(tp->next) {
-                  tp->next->prev = tp->prev;
-               } else {
-                  taskEntriesTail = tp->prev;
-               }
-               Release(tp);
-            }
-            RequireTaskUpdate();
-            UpdateNetClientList();
-            return;
+   ClientEntry *cp;
+   const int index = FindClientEntry(np, &cp);
+   if(index < 0) {
+      return;
+   }
+
+   tp = taskEntries[index];
+   if(cp->prev) {
+      cp->prev->next = cp->next;
+   } else {
+      tp->clients = cp->next;
+   }
+   if(cp->next) {
+      cp->next->prev = cp->prev;
+   }
+   Release(cp);
+
+   if(!tp->clients) {
+      if(np->className && settings.groupTasks) {
+         TaskEntry **ep = &classHash[GetClassHash(np->className)];
+         while(*ep != tp) {
+            ep = &(*ep)->hashNext;
          }
+         *ep = tp->hashNext;
       }
+      taskEntryCount -= 1;
+      memmove(&taskEntries[index], &taskEntries[index + 1],
+              (taskEntryCount - index) * sizeof(TaskEntry*));
+      Release(tp);
    }
+
+   RedrawTaskBars();
+   RequireTaskUpdate();
+   UpdateNetClientList();
 }
 
 /** Update all task bars. */
@@ -673,7 +715,7 @@ void UpdateTaskBar(void)
 
    for(bp = bars; bp; bp = bp->next) {
       if(bp->layout == LAYOUT_VERTICAL) {
-         TaskEntry *tp;
+         unsigned i;
          lastHeight = bp->cp->requestedHeight;
          if(bp->userHeight > 0) {
             bp->itemHeight = bp->userHeight;
@@ -681,8 +723,8 @@ void UpdateTaskBar(void)
             bp->itemHeight = GetStringHeight(FONT_TASKLIST) + 12;
          }
          bp->cp->requestedHeight = 0;
-         for(tp = taskEntries; tp; tp = tp->next) {
-            if(ShouldShowEntry(tp)) {
+         for(i = 0; i < taskEntryCount; i++) {
+            if(ShouldShowEntry(taskEntries[i])) {
                bp->cp->requestedHeight += bp->itemHeight;
             }
          }
@@ -696,50 +738,90 @@ void UpdateTaskBar(void)
    }
 }
 
-/** Signal task bar (for popups). */
-void SignalTaskbar(const TimeType *now, int x, int y, Window w, void *data)
+/** Show the popup for a task bar entry. */
+void ShowTaskPopup(void *data, int x, int y)
 {
 
    TaskBarType *bp = (TaskBarType*)data;
    TaskEntry *ep;
 
-   if(w == bp->cp->tray->window &&
-      abs(bp->mousex - x) < settings.doubleClickDelta &&
-      abs(bp->mousey - y) < settings.doubleClickDelta) {
-      if(GetTimeDifference(now, &bp->mouseTime) >= settings.popupDelay) {
-         ep = GetEntry(bp, x - bp->cp->screenx, y - bp->cp->screeny);
-         if(settings.groupTasks) {
-            if(ep && ep->clients->client->className) {
-               ShowPopup(x, y, ep->clients->client->className, POPUP_TASK);
-            }
-         } else {
-            if(ep && ep->clients->client->name) {
-               ShowPopup(x, y, ep->clients->client->name, POPUP_TASK);
-            }
-         }
+   ep = GetEntry(bp, x - bp->cp->screenx, y - bp->cp->screeny);
+   if(settings.groupTasks) {
+      if(ep && ep->clients->client->className) {
+         ShowPopup(x, y, ep->clients->client->className, POPUP_TASK);
+      }
+   } else {
+      if(ep && ep->clients->client->name) {
+         ShowPopup(x, y, ep->clients->client->name, POPUP_TASK);
       }
    }
 
 }
 
-/** Draw a specific task bar. */
-void Render(const TaskBarType *bp)
+/** Draw a specific task bar.
+ * Only cells whose contents changed since the last call are drawn and
+ * copied to the tray unless the layout changed.
+ */
+void Render(TaskBarType *bp)
 {
-   TaskEntry *tp;
-   char *displayName;
-   ButtonNode button;
-   int x, y;
+   unsigned count;
+   unsigned i;
+   char full;
 
    if(JUNLIKELY(shouldExit)) {
       return;
    }
 
-   ClearTrayDrawable(bp->cp);
-   if(!taskEntries) {
+   /* Redraw everything if the cells moved. */
+   count = 0;
+   for(i = 0; i < taskEntryCount; i++) {
+      if(ShouldShowEntry(taskEntries[i])) {
+         count += 1;
+      }
+   }
+   full = bp->redraw
+       || count != bp->cellCount
+       || bp->itemWidth != bp->cellWidth
+       || bp->itemHeight != bp->cellHeight;
+   if(full) {
+      ClearCells(bp);
+      if(count > bp->cellCount) {
+         if(bp->cells) {
+            Release(bp->cells);
+         }
+         bp->cells = Allocate(sizeof(TaskCell) * count);
+      }
+      if(count > 0) {
+         memset(bp->cells, 0, sizeof(TaskCell) * count);
+      }
+      bp->cellCount = count;
+      bp->cellWidth = bp->itemWidth;
+      bp->cellHeight = bp->itemHeight;
+      bp->redraw = 0;
+      ClearTrayDrawable(bp->cp);
+   }
+
+   if(count > 0) {
+      RenderCells(bp, full);
+   }
+   if(full) {
       UpdateSpecificTray(bp->cp->tray, bp->cp);
-      return;
    }
 
+}
+
+/** Draw the task bar cells that changed.
+ * Changed cells are copied to the tray unless full is set.
+ */
+void RenderCells(TaskBarType *bp, char full)
+{
+   char *displayName;
+   ButtonNode button;
+   unsigned i;
+   TaskCell *cell;
+   int x, y;
+   int damageStart, damageEnd;
+
    ResetButton(&button, bp->cp->pixmap);
    button.border = settings.taskListDecorations == DECO_MOTIF;
    button.font = FONT_TASKLIST;
@@ -749,8 +831,12 @@ void Render(const TaskBarType *bp)
 
    x = 0;
    y = 0;
-   for(tp = taskEntries; tp; tp = tp->next) {
+   cell = bp->cells;
+   damageStart = -1;
+   damageEnd = -1;
+   for(i = 0; i < taskEntryCount; i++) {
 
+      TaskEntry *tp = taskEntries[i];
       if(!ShouldShowEntry(tp)) {
          continue;
       }
@@ -782,6 +868,8 @@ void Render(const TaskBarType *bp)
          button.icon = tp->clients->client->icon;
       }
       displayName = NULL;
+      button.text = NULL;
+      button.title = NULL;
       if(bp->labeled) {
          if(tp->clients->client->className && settings.groupTasks) {
             if(clientCount != 1) {
@@ -793,15 +881,59 @@ void Render(const TaskBarType *bp)
             } else {
                button.text = tp->clients->client->className;
             }
-         } else {
+         } else if(tp->clients->client->name) {
+            button.title = &tp->clients->client->title;
             button.text = tp->clients->client->name;
          }
       }
-      DrawButton(&button);
+
+      /* Draw the cell only if it changed. */
+      if(   !cell->valid
+         || cell->entry != tp
+         || cell->type != button.type
+         || cell->icon != button.icon
+         || (cell->text == NULL) != (button.text == NULL)
+         || (cell->text && strcmp(cell->text, button.text))) {
+
+         if(cell->text) {
+            Release(cell->text);
+         }
+         cell->entry = tp;
+         cell->type = button.type;
+         cell->icon = button.icon;
+         cell->text = button.text ? CopyString(button.text) : NULL;
+         cell->valid = 1;
+
+         if(button.title) {
+            button.text = NULL;
+         }
+         DrawButton(&button);
+
+         /* Extend the damaged run of cells. */
+         if(damageStart < 0) {
+            damageStart = bp->layout == LAYOUT_HORIZONTAL ? x : y;
+         }
+         damageEnd = bp->layout == LAYOUT_HORIZONTAL
+                   ? x + bp->itemWidth : y + bp->itemHeight;
+
+      } else if(damageStart >= 0 && !full) {
+
+         /* Copy the run of damaged cells that just ended. */
+         if(bp->layout == LAYOUT_HORIZONTAL) {
+            UpdateSpecificTrayArea(bp->cp->tray, bp->cp, damageStart, 0,
+                                   damageEnd - damageStart, bp->itemHeight);
+         } else {
+            UpdateSpecificTrayArea(bp->cp->tray, bp->cp, 0, damageStart,
+                                   bp->itemWidth, damageEnd - damageStart);
+         }
+         damageStart = -1;
+
+      }
       if(displayName) {
          Release(displayName);
       }
 
+      cell += 1;
       if(bp->layout == LAYOUT_HORIZONTAL) {
          x += bp->itemWidth;
       } else {
@@ -809,92 +941,168 @@ void Render(const TaskBarType *bp)
       }
    }
 
-   UpdateSpecificTray(bp->cp->tray, bp->cp);
+   if(damageStart >= 0 && !full) {
+      if(bp->layout == LAYOUT_HORIZONTAL) {
+         UpdateSpecificTrayArea(bp->cp->tray, bp->cp, damageStart, 0,
+                                damageEnd - damageStart, bp->itemHeight);
+      } else {
+         UpdateSpecificTrayArea(bp->cp->tray, bp->cp, 0, damageStart,
+                                bp->itemWidth, damageEnd - damageStart);
+      }
+   }
 
 }
 
-/** Focus the next client in the task bar. */
-void FocusNext(void)
+/** Release the contents of the task bar cells. */
+void ClearCells(TaskBarType *bp)
 {
-   TaskEntry *tp;
-
-   /* Find the current entry. */
-   for(tp = taskEntries; tp; tp = tp->next) {
-      ClientEntry *cp;
-      for(cp = tp->clients; cp; cp = cp->next) {
-         if(cp->client->state.status & (STAT_CANFOCUS | STAT_TAKEFOCUS)) {
-            if(ShouldFocus(cp->client, 1)) {
-               if(cp->client->state.status & STAT_ACTIVE) {
-                  cp = cp->next;
-                  goto ClientFound;
-               }
-            }
-         }
+   unsigned x;
+   for(x = 0; x < bp->cellCount; x++) {
+      if(bp->cells[x].text) {
+         Release(bp->cells[x].text);
+         bp->cells[x].text = NULL;
       }
+      bp->cells[x].valid = 0;
    }
-ClientFound:
+}
 
-   /* Move to the next group. */
-   if(tp) {
-      do {
-         tp = tp->next;
-      } while(tp && !ShouldFocusEntry(tp));
+/** Redraw every cell of every task bar on the next update. */
+void RedrawTaskBars(void)
+{
+   TaskBarType *bp;
+   for(bp = bars; bp; bp = bp->next) {
+      bp->redraw = 1;
    }
-   if(!tp) {
-      /* Wrap around; start at the beginning. */
-      for(tp = taskEntries; tp; tp = tp->next) {
-         if(ShouldFocusEntry(tp)) {
-            break;
+}
+
+/** Redraw the task bar entry of a client on the next update. */
+void InvalidateTaskBarClient(const ClientNode *np)
+{
+   TaskBarType *bp;
+   for(bp = bars; bp; bp = bp->next) {
+      unsigned x;
+      if(bp->redraw) {
+         /* Entries may have been removed; all cells are drawn anyway. */
+         continue;
+      }
+      for(x = 0; x < bp->cellCount; x++) {
+         const ClientEntry *cp;
+         if(!bp->cells[x].entry) {
+            continue;
+         }
+         for(cp = bp->cells[x].entry->clients; cp; cp = cp->next) {
+            if(cp->client == np) {
+               bp->cells[x].valid = 0;
+               break;
+            }
          }
       }
    }
+}
 
-   /* Focus the group if one exists. */
-   if(tp) {
-      FocusGroup(tp);
-   }
+/** Focus the next client in the task bar. */
+void FocusNext(void)
+{
+   FocusNextEntry(1);
 }
 
 /** Focus the previous client in the task bar. */
 void FocusPrevious(void)
 {
-   TaskEntry *tp;
+   FocusNextEntry(-1);
+}
 
-   /* Find the current entry. */
-   for(tp = taskEntries; tp; tp = tp->next) {
-      ClientEntry *cp;
-      for(cp = tp->clients; cp; cp = cp->next) {
-         if(cp->client->state.status & (STAT_CANFOCUS | STAT_TAKEFOCUS)) {
-            if(ShouldFocus(cp->client, 1)) {
-               if(cp->client->state.status & STAT_ACTIVE) {
-                  cp = cp->next;
-                  goto ClientFound;
-               }
-            }
-         }
+/** Focus the next focusable entry in the specified direction. */
+void FocusNextEntry(int direction)
+{
+   int index;
+   unsigned i;
+
+   /* Start after the current entry (or at the end to wrap around). */
+   index = FindActiveEntry();
+   if(index < 0) {
+      index = direction > 0 ? -1 : (int)taskEntryCount;
+   }
+
+   for(i = 0; i < taskEntryCount; i++) {
+      index += direction;
+      if(index < 0) {
+         index = taskEntryCount - 1;
+      } else if(index >= (int)taskEntryCount) {
+         index = 0;
       }
+      if(ShouldFocusEntry(taskEntries[index])) {
+         FocusGroup(taskEntries[index]);
+         return;
+      }
+   }
+}
+
+/** Get the index of the entry containing the active client.
+ * @return The index (-1 if there is no active client in the task bar).
+ */
+int FindActiveEntry(void)
+{
+   ClientEntry *cp;
+   ClientNode *np = GetActiveClient();
+   if(   !np
+      || !(np->state.status & (STAT_CANFOCUS | STAT_TAKEFOCUS))
+      || !ShouldFocus(np, 1)) {
+      return -1;
    }
-ClientFound:
+   return FindClientEntry(np, &cp);
+}
+
+/** Get the index of the entry containing a client.
+ * Grouped clients are found through the class hash.
+ * @param np The client.
+ * @param result Set to the client's entry in the group.
+ * @return The index (-1 if the client is not in the task bar).
+ */
+int FindClientEntry(const ClientNode *np, ClientEntry **result)
+{
+   const TaskEntry *group = NULL;
+   unsigned i;
 
-   /* Move to the previous group. */
-   if(tp) {
-      do {
-         tp = tp->prev;
-      } while(tp && !ShouldFocusEntry(tp));
+   if(np->className && settings.groupTasks) {
+      group = FindGroup(np->className);
    }
-   if(!tp) {
-      /* Wrap around; start at the end. */
-      for(tp = taskEntriesTail; tp; tp = tp->prev) {
-         if(ShouldFocusEntry(tp)) {
-            break;
+   for(i = 0; i < taskEntryCount; i++) {
+      ClientEntry *cp;
+      if(group && taskEntries[i] != group) {
+         continue;
+      }
+      for(cp = taskEntries[i]->clients; cp; cp = cp->next) {
+         if(cp->client == np) {
+            *result = cp;
+            return i;
          }
       }
    }
+   return -1;
+}
 
-   /* Focus the group if one exists. */
-   if(tp) {
-      FocusGroup(tp);
+/** Get the hash bucket for a class name. */
+unsigned GetClassHash(const char *className)
+{
+   unsigned hash = 0;
+   while(*className) {
+      hash = hash * 31 + (unsigned char)*className;
+      className += 1;
    }
+   return hash % CLASS_HASH_SIZE;
+}
+
+/** Get the group for a class name (NULL if there is none). */
+TaskEntry *FindGroup(const char *className)
+{
+   TaskEntry *tp;
+   for(tp = classHash[GetClassHash(className)]; tp; tp = tp->hashNext) {
+      if(!strcmp(tp->clients->client->className, className)) {
+         return tp;
+      }
+   }
+   return NULL;
 }
 
 /** Determine if there is anything to show for the specified entry. */
@@ -927,10 +1135,22 @@ char ShouldFocusEntry(const TaskEntry *tp)
 TaskEntry *GetEntry(TaskBarType *bar, int x, int y)
 {
    TaskEntry *tp;
+   unsigned i;
    int offset;
 
+   /* Cells map directly to what is shown unless entries were removed. */
+   if(!bar->redraw && bar->itemWidth > 0 && bar->itemHeight > 0) {
+      if(bar->layout == LAYOUT_HORIZONTAL) {
+         i = x >= 0 ? x / bar->itemWidth : bar->cellCount;
+      } else {
+         i = y >= 0 ? y / bar->itemHeight : bar->cellCount;
+      }
+      return i < bar->cellCount ? bar->cells[i].entry : NULL;
+   }
+
    offset = 0;
-   for(tp = taskEntries; tp; tp = tp->next) {
+   for(i = 0; i < taskEntryCount; i++) {
+      tp = taskEntries[i];
       if(!ShouldShowEntry(tp)) {
          continue;
       }
@@ -991,8 +1211,8 @@ void SetTaskBarLabeled(TrayComponentType *cp, char labeled)
 /** Maintain the _NET_CLIENT_LIST[_STACKING] properties on the root. */
 void UpdateNetClientList(void)
 {
-   TaskEntry *tp;
    ClientNode *client;
+   unsigned i;
    Window *windows;
    unsigned int count;
    int layer;
@@ -1006,9 +1226,9 @@ void UpdateNetClientList(void)
 
    /* Set _NET_CLIENT_LIST */
    count = 0;
-   for(tp = taskEntries; tp; tp = tp->next) {
+   for(i = 0; i < taskEntryCount; i++) {
       ClientEntry *cp;
-      for(cp = tp->clients; cp; cp = cp->next) {
+      for(cp = taskEntries[i]->clients; cp; cp = cp->next) {
          windows[count] = cp->client->window;
          count += 1;
       }
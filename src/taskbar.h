@@ -33,6 +33,16 @@ void AddClientToTaskBar(struct ClientNode *np);
  */
 void RemoveClientFromTaskBar(struct ClientNode *np);
 
+/** Redraw every cell of every task bar on the next update. */
+void RedrawTaskBars(void);
+
+/** Redraw the task bar entry of a client on the next update.
+ * Changes to titles and state are detected automatically; this is
+ * needed when the contents of the client's icon change.
+ * @param np The client.
+ */
+void InvalidateTaskBarClient(const struct ClientNode *np);
+
 /** Update all task bars. */
 void UpdateTaskBar(void);
 
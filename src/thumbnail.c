@@ -0,0 +1,429 @@
+/**
+ * @file thumbnail.c
+ *
+ * @brief Live window thumbnails (Composite and Damage extensions).
+ *
+ * Top-level windows are redirected (automatically, so the server still
+ * draws them) and a small scaled copy of each window is kept. A copy is
+ * only refreshed after its window reports damage and at most once per
+ * refresh period: the first damage starts a one-shot timeout, so idle
+ * windows cause no wakeups and busy windows cannot redraw the pager
+ * faster than the configured rate.
+ *
+ */
+
+#include "jwm.h"
+#include "thumbnail.h"
+#include "client.h"
+#include "clientlist.h"
+#include "border.h"
+#include "event.h"
+#include "error.h"
+#include "timing.h"
+#include "main.h"
+#include "misc.h"
+
+#ifdef USE_COMPOSITE
+
+/** Number of buckets in the thumbnail hash. */
+#define THUMBNAIL_HASH_SIZE 64
+
+/** Total size of all thumbnails in bytes. */
+#define THUMBNAIL_BUDGET (16 * 1024 * 1024)
+
+/** Scaled copy of a window. */
+typedef struct ThumbnailNode {
+   Window window;             /**< The top-level window. */
+   Damage damage;             /**< Damage object for the window. */
+   XRenderPictFormat *format; /**< Format of the window. */
+   Pixmap pixmap;             /**< The scaled copy (or None). */
+   Picture picture;           /**< Picture of pixmap. */
+   int width, height;         /**< Size of the scaled copy. */
+   int requestWidth;          /**< Size last requested. */
+   int requestHeight;
+   unsigned int serial;       /**< Incremented when refreshed. */
+   char damaged;              /**< Set if the window changed. */
+   struct ThumbnailNode *next;
+} ThumbnailNode;
+
+static ThumbnailNode *thumbnailHash[THUMBNAIL_HASH_SIZE];
+static unsigned int thumbnailRate;
+static unsigned int damagedCount;
+static unsigned long thumbnailBytes;
+static char haveThumbnails;
+static char refreshPending;
+static int damageEvent;
+
+static Window GetThumbnailWindow(const ClientNode *np);
+static ThumbnailNode *FindThumbnail(Window w);
+static ThumbnailNode *CreateThumbnail(const ClientNode *np);
+static void RefreshThumbnail(ThumbnailNode *tp, const ClientNode *np);
+static void ReleaseThumbnail(ThumbnailNode *tp);
+static char IsThumbnailShown(const ClientNode *np);
+static void ScheduleThumbnails(void);
+static void SignalThumbnails(const TimeType *now, int x, int y, Window w,
+                             void *data);
+
+/** Initialize thumbnail data. */
+void InitializeThumbnails(void)
+{
+   memset(thumbnailHash, 0, sizeof(thumbnailHash));
+   thumbnailRate = 0;
+   damagedCount = 0;
+   thumbnailBytes = 0;
+   haveThumbnails = 0;
+   refreshPending = 0;
+}
+
+/** Startup thumbnails. */
+void StartupThumbnails(void)
+{
+   int event, error;
+
+   if(thumbnailRate == 0) {
+      return;
+   }
+   if(!haveRender
+      || !JXCompositeQueryExtension(display, &event, &error)
+      || !JXDamageQueryExtension(display, &damageEvent, &error)) {
+      Warning(_("pager thumbnails require Composite, Damage, and XRender"));
+      return;
+   }
+
+   JXCompositeRedirectSubwindows(display, rootWindow,
+                                 CompositeRedirectAutomatic);
+   haveThumbnails = 1;
+   Debug("thumbnails enabled");
+}
+
+/** Shutdown thumbnails. */
+void ShutdownThumbnails(void)
+{
+   unsigned int i;
+
+   if(!haveThumbnails) {
+      return;
+   }
+
+   for(i = 0; i < THUMBNAIL_HASH_SIZE; i++) {
+      while(thumbnailHash[i]) {
+         ThumbnailNode *tp = thumbnailHash[i]->next;
+         ReleaseThumbnail(thumbnailHash[i]);
+         thumbnailHash[i] = tp;
+      }
+   }
+   damagedCount = 0;
+   thumbnailBytes = 0;
+
+   CancelTimeout(SignalThumbnails, NULL);
+   refreshPending = 0;
+   JXCompositeUnredirectSubwindows(display, rootWindow,
+                                   CompositeRedirectAutomatic);
+   haveThumbnails = 0;
+}
+
+/** Request thumbnails. */
+void RequireThumbnails(unsigned int rate)
+{
+   thumbnailRate = Max(thumbnailRate, Min(rate, 1000));
+}
+
+/** Get the top-level window of a client. */
+Window GetThumbnailWindow(const ClientNode *np)
+{
+   return np->parent != None ? np->parent : np->window;
+}
+
+/** Find the thumbnail for a window. */
+ThumbnailNode *FindThumbnail(Window w)
+{
+   ThumbnailNode *tp;
+   for(tp = thumbnailHash[w % THUMBNAIL_HASH_SIZE]; tp; tp = tp->next) {
+      if(tp->window == w) {
+         return tp;
+      }
+   }
+   return NULL;
+}
+
+/** Start tracking a window.
+ * The thumbnail is filled on the next refresh.
+ */
+ThumbnailNode *CreateThumbnail(const ClientNode *np)
+{
+   XWindowAttributes attr;
+   ThumbnailNode *tp;
+   const Window w = GetThumbnailWindow(np);
+
+   if(JUNLIKELY(!JXGetWindowAttributes(display, w, &attr))) {
+      return NULL;
+   }
+
+   tp = Allocate(sizeof(ThumbnailNode));
+   memset(tp, 0, sizeof(ThumbnailNode));
+   tp->window = w;
+   tp->format = JXRenderFindVisualFormat(display, attr.visual);
+   tp->damage = JXDamageCreate(display, w, XDamageReportNonEmpty);
+   tp->pixmap = None;
+   tp->picture = None;
+   tp->damaged = 1;
+   damagedCount += 1;
+
+   tp->next = thumbnailHash[w % THUMBNAIL_HASH_SIZE];
+   thumbnailHash[w % THUMBNAIL_HASH_SIZE] = tp;
+   return tp;
+}
+
+/** Release a thumbnail. */
+void ReleaseThumbnail(ThumbnailNode *tp)
+{
+   if(tp->picture != None) {
+      JXRenderFreePicture(display, tp->picture);
+      JXFreePixmap(display, tp->pixmap);
+      thumbnailBytes -= 4UL * tp->width * tp->height;
+   }
+   if(tp->damaged) {
+      damagedCount -= 1;
+   }
+   JXDamageDestroy(display, tp->damage);
+   Release(tp);
+}
+
+/** Draw the thumbnail of a client. */
+char PutThumbnail(const ClientNode *np, Drawable d,
+                  int x, int y, int width, int height)
+{
+   XRenderPictureAttributes pa;
+   XTransform xf;
+   ThumbnailNode *tp;
+   Picture dest;
+
+   if(!haveThumbnails) {
+      return 0;
+   }
+
+   tp = FindThumbnail(GetThumbnailWindow(np));
+   if(!tp) {
+      tp = CreateThumbnail(np);
+      if(!tp) {
+         return 0;
+      }
+   }
+
+   /* Refresh at the new size if the size changed. */
+   if(tp->requestWidth != width || tp->requestHeight != height) {
+      tp->requestWidth = width;
+      tp->requestHeight = height;
+      if(!tp->damaged) {
+         tp->damaged = 1;
+         damagedCount += 1;
+      }
+   }
+   if(tp->damaged && IsThumbnailShown(np)) {
+      ScheduleThumbnails();
+   }
+   if(tp->picture == None) {
+      return 0;
+   }
+
+   /* Draw the copy we have (scaled if the size changed). */
+   memset(&xf, 0, sizeof(xf));
+   xf.matrix[0][0] = (tp->width << 16) / width;
+   xf.matrix[1][1] = (tp->height << 16) / height;
+   xf.matrix[2][2] = 65536;
+   JXRenderSetPictureTransform(display, tp->picture, &xf);
+
+   pa.subwindow_mode = IncludeInferiors;
+   dest = JXRenderCreatePicture(display, d,
+                                JXRenderFindVisualFormat(display, rootVisual),
+                                CPSubwindowMode, &pa);
+   JXRenderComposite(display, PictOpSrc, tp->picture, None, dest,
+                     0, 0, 0, 0, x, y, width, height);
+   JXRenderFreePicture(display, dest);
+   return 1;
+}
+
+/** Get the version of the thumbnail of a client. */
+unsigned int GetThumbnailSerial(const ClientNode *np)
+{
+   const ThumbnailNode *tp;
+   if(!haveThumbnails) {
+      return 0;
+   }
+   tp = FindThumbnail(GetThumbnailWindow(np));
+   return tp ? tp->serial : 0;
+}
+
+/** Release the thumbnail of a client. */
+void RemoveThumbnail(const ClientNode *np)
+{
+   ThumbnailNode **tp;
+   Window w;
+
+   if(!haveThumbnails) {
+      return;
+   }
+
+   w = GetThumbnailWindow(np);
+   tp = &thumbnailHash[w % THUMBNAIL_HASH_SIZE];
+   for(; *tp; tp = &(*tp)->next) {
+      if((*tp)->window == w) {
+         ThumbnailNode *temp = *tp;
+         *tp = temp->next;
+         ReleaseThumbnail(temp);
+         return;
+      }
+   }
+}
+
+/** Process a damage event. */
+char ProcessThumbnailEvent(const XEvent *event)
+{
+   const XDamageNotifyEvent *de;
+   ThumbnailNode *tp;
+
+   if(!haveThumbnails || event->type != damageEvent + XDamageNotify) {
+      return 0;
+   }
+
+   /* The damage is not subtracted until the thumbnail is refreshed,
+    * so no more events are sent for this window until then. */
+   de = (const XDamageNotifyEvent*)event;
+   tp = FindThumbnail(de->drawable);
+   if(tp && !tp->damaged) {
+      tp->damaged = 1;
+      damagedCount += 1;
+      ScheduleThumbnails();
+   }
+   return 1;
+}
+
+/** Refresh the thumbnail of a visible client. */
+void RefreshThumbnail(ThumbnailNode *tp, const ClientNode *np)
+{
+   XRenderPictureAttributes pa;
+   XTransform xf;
+   Pixmap contents;
+   Picture source;
+   int north, south, east, west;
+   int frameWidth, frameHeight;
+   const int width = tp->requestWidth;
+   const int height = tp->requestHeight;
+
+   if(width <= 0 || height <= 0 || !tp->format) {
+      return;
+   }
+
+   /* Make room for the scaled copy. */
+   if(tp->width != width || tp->height != height) {
+      const unsigned long bytes = 4UL * width * height;
+      if(tp->picture != None) {
+         JXRenderFreePicture(display, tp->picture);
+         JXFreePixmap(display, tp->pixmap);
+         thumbnailBytes -= 4UL * tp->width * tp->height;
+         tp->picture = None;
+         tp->pixmap = None;
+      }
+      tp->width = 0;
+      tp->height = 0;
+      if(thumbnailBytes + bytes > THUMBNAIL_BUDGET) {
+         /* Out of budget; the pager draws a plain rectangle. */
+         return;
+      }
+      tp->pixmap = JXCreatePixmap(display, rootWindow, width, height,
+                                  rootDepth);
+      tp->picture = JXRenderCreatePicture(display, tp->pixmap,
+                                 JXRenderFindVisualFormat(display, rootVisual),
+                                 0, NULL);
+      JXRenderSetPictureFilter(display, tp->picture, FilterBilinear, NULL, 0);
+      tp->width = width;
+      tp->height = height;
+      thumbnailBytes += bytes;
+   }
+
+   /* Scale the window contents into the copy. */
+   GetBorderSize(&np->state, &north, &south, &east, &west);
+   frameWidth = np->width + east + west;
+   frameHeight = np->height + north + south;
+   if(np->state.status & STAT_SHADED) {
+      frameHeight = north + south;
+   }
+   if(np->parent == None) {
+      frameWidth = np->width;
+      frameHeight = np->height;
+   }
+
+   contents = JXCompositeNameWindowPixmap(display, tp->window);
+   pa.subwindow_mode = IncludeInferiors;
+   source = JXRenderCreatePicture(display, contents, tp->format,
+                                  CPSubwindowMode, &pa);
+   memset(&xf, 0, sizeof(xf));
+   xf.matrix[0][0] = (frameWidth << 16) / width;
+   xf.matrix[1][1] = (frameHeight << 16) / height;
+   xf.matrix[2][2] = 65536;
+   JXRenderSetPictureTransform(display, source, &xf);
+   JXRenderSetPictureFilter(display, source, FilterBilinear, NULL, 0);
+   JXRenderComposite(display, PictOpSrc, source, None, tp->picture,
+                     0, 0, 0, 0, 0, 0, width, height);
+   JXRenderFreePicture(display, source);
+   JXFreePixmap(display, contents);
+
+   tp->serial += 1;
+}
+
+/** Determine if a client is shown (only shown windows have contents). */
+char IsThumbnailShown(const ClientNode *np)
+{
+   return (np->state.status & (STAT_MAPPED | STAT_SHADED))
+      && !(np->state.status & (STAT_HIDDEN | STAT_MINIMIZED));
+}
+
+/** Refresh damaged thumbnails after the refresh period.
+ * Damage received before the timeout expires is handled at that time.
+ */
+void ScheduleThumbnails(void)
+{
+   if(!refreshPending) {
+      refreshPending = 1;
+      RegisterTimeout(1000 / thumbnailRate, SignalThumbnails, NULL);
+   }
+}
+
+/** Refresh damaged thumbnails (at most once per refresh period). */
+void SignalThumbnails(const TimeType *now, int x, int y, Window w,
+                      void *data)
+{
+   ClientNode *np;
+   unsigned int layer;
+   char refreshed;
+
+   refreshPending = 0;
+   if(damagedCount == 0) {
+      return;
+   }
+
+   /* Only windows that are shown have contents. */
+   refreshed = 0;
+   for(layer = FIRST_LAYER; layer <= LAST_LAYER; layer++) {
+      for(np = nodes[layer]; np; np = np->next) {
+         ThumbnailNode *tp;
+         if(!IsThumbnailShown(np)) {
+            continue;
+         }
+         tp = FindThumbnail(GetThumbnailWindow(np));
+         if(tp && tp->damaged) {
+            JXDamageSubtract(display, tp->damage, None, None);
+            tp->damaged = 0;
+            damagedCount -= 1;
+            RefreshThumbnail(tp, np);
+            refreshed = 1;
+         }
+      }
+   }
+
+   if(refreshed) {
+      RequirePagerUpdate();
+   }
+}
+
+#endif /* USE_COMPOSITE */
@@ -0,0 +1,75 @@
+/**
+ * @file thumbnail.h
+ *
+ * @brief Live window thumbnails (Composite and Damage extensions).
+ *
+ */
+
+#ifndef THUMBNAIL_H
+#define THUMBNAIL_H
+
+struct ClientNode;
+
+#ifdef USE_COMPOSITE
+
+/*@{*/
+void InitializeThumbnails(void);
+void StartupThumbnails(void);
+void ShutdownThumbnails(void);
+#define DestroyThumbnails()   (void)(0)
+/*@}*/
+
+/** Request thumbnails.
+ * This must be called before startup.
+ * @param rate The maximum number of times per second to refresh a
+ * thumbnail.
+ */
+void RequireThumbnails(unsigned int rate);
+
+/** Draw the thumbnail of a client.
+ * @param np The client.
+ * @param d The drawable.
+ * @param x The x-coordinate.
+ * @param y The y-coordinate.
+ * @param width The width of the thumbnail.
+ * @param height The height of the thumbnail.
+ * @return 1 if drawn, 0 if no thumbnail is available.
+ */
+char PutThumbnail(const struct ClientNode *np, Drawable d,
+                  int x, int y, int width, int height);
+
+/** Get the version of the thumbnail of a client.
+ * This changes whenever the thumbnail is refreshed.
+ * @param np The client.
+ * @return The version (0 if there is no thumbnail).
+ */
+unsigned int GetThumbnailSerial(const struct ClientNode *np);
+
+/** Release the thumbnail of a client.
+ * @param np The client that is being removed.
+ */
+void RemoveThumbnail(const struct ClientNode *np);
+
+/** Process a damage event.
+ * @param event The event.
+ * @return 1 if handled, 0 otherwise.
+ */
+char ProcessThumbnailEvent(const XEvent *event);
+
+#else
+
+#define THUMBNAIL_DUMMY_FUNCTION ((void)0)
+
+#define InitializeThumbnails()            THUMBNAIL_DUMMY_FUNCTION
+#define StartupThumbnails()               THUMBNAIL_DUMMY_FUNCTION
+#define ShutdownThumbnails()              THUMBNAIL_DUMMY_FUNCTION
+#define DestroyThumbnails()               THUMBNAIL_DUMMY_FUNCTION
+#define RequireThumbnails( a )            THUMBNAIL_DUMMY_FUNCTION
+#define PutThumbnail( a, b, c, d, e, f )  0
+#define GetThumbnailSerial( a )           0
+#define RemoveThumbnail( a )              THUMBNAIL_DUMMY_FUNCTION
+#define ProcessThumbnailEvent( a )        0
+
+#endif /* USE_COMPOSITE */
+
+#endif /* THUMBNAIL_H */
@@ -9,9 +9,78 @@
 
 #include "jwm.h"
 #include "timing.h"
+#include "misc.h"
+
+#ifdef HAVE_LANGINFO_H
+#  include <langinfo.h>
+#endif
 
 static const unsigned long MAX_TIME_SECONDS = 60;
 
+/** Size of a formatted time string. */
+#define TIME_STRING_SIZE 128
+
+/** Zone offsets only change on multiples of this many seconds. */
+#define ZONE_PERIOD (15 * 60)
+
+/** Largest TZif file that is loaded. */
+#define ZONE_MAX_SIZE (1 << 20)
+
+/** Offset from UTC in effect for a period of time. */
+typedef struct ZoneInfo {
+   long offset;            /**< Seconds east of UTC. */
+   char isdst;             /**< Set for daylight saving time. */
+   char abbr[16];          /**< Abbreviation (for example, "EST"). */
+} ZoneInfo;
+
+/** Cached time zone data.
+ * Transitions come from the zone's TZif file when it can be read;
+ * otherwise (and after the last transition) the C library is asked.
+ */
+typedef struct ZoneNode {
+   char *name;             /**< Name in tzset() format (NULL for local). */
+   long *times;            /**< Transition times. */
+   unsigned char *indexes; /**< Type in effect from each transition. */
+   ZoneInfo *types;        /**< Types (NULL if the file was not loaded). */
+   char *footer;           /**< Rule for times after the last transition. */
+   unsigned int timeCount; /**< Number of transitions. */
+   unsigned int typeCount; /**< Number of types. */
+   ZoneInfo info;          /**< Information for the current period. */
+   long start;             /**< Start of the current period. */
+   long end;               /**< End of the current period. */
+   struct ZoneNode *next;
+} ZoneNode;
+
+/** Part of a precompiled time format. */
+typedef struct TimeFormatPart {
+   char type;              /**< Conversion done here (0 for strftime). */
+   char *text;             /**< Format for strftime. */
+   struct TimeFormatPart *next;
+} TimeFormatPart;
+
+/** Precompiled time format. */
+struct TimeFormatType {
+   ZoneNode *zone;         /**< The time zone. */
+   TimeFormatPart *parts;  /**< Parts of the format. */
+   int resolution;         /**< Seconds between possible changes. */
+   long lastUpdate;        /**< Time the text was formatted. */
+   long nextUpdate;        /**< Time the text could change next. */
+   char text[TIME_STRING_SIZE];  /**< The current text. */
+};
+
+static ZoneNode *zones = NULL;
+
+static TimeFormatPart *AddTimeFormatPart(TimeFormatType *tf,
+                                         TimeFormatPart *last, char type,
+                                         const char *text, unsigned len);
+static char *ExpandTimeFormat(const char *format);
+static ZoneNode *GetZone(const char *name);
+static void UpdateZone(ZoneNode *zp, long t);
+static void GetSystemZoneInfo(const char *zone, long t, ZoneInfo *info);
+static long ReadZoneInt32(const unsigned char *p);
+static long ReadZoneInt64(const unsigned char *p);
+static void LoadZone(ZoneNode *zp, const char *name);
+
 /** Get the current time in milliseconds since midnight 1970-01-01 UTC. */
 void GetCurrentTime(TimeType *t)
 {
@@ -53,15 +122,336 @@ unsigned long GetTimeDifference(const TimeType *t1, const TimeType *t2)
 
 }
 
-/** Get the current time. */
+/** Get a time string. */
 const char *GetTimeString(const char *format, const char *zone)
+{
+   static char str[TIME_STRING_SIZE];
+   TimeFormatType *tf;
+   TimeType now;
+
+   GetCurrentTime(&now);
+   tf = CreateTimeFormat(format, zone);
+   UpdateTimeFormat(tf, &now);
+   strcpy(str, tf->text);
+   DestroyTimeFormat(tf);
+
+   return str;
+}
+
+/** Create a time format. */
+TimeFormatType *CreateTimeFormat(const char *format, const char *zone)
+{
+   TimeFormatType *tf;
+   TimeFormatPart *part;
+   char *expanded;
+   char *chunk;
+   unsigned len;
+   unsigned x;
+
+   tf = Allocate(sizeof(TimeFormatType));
+   tf->zone = GetZone(zone);
+   tf->parts = NULL;
+   tf->resolution = 60;
+   tf->text[0] = 0;
+   tf->lastUpdate = 0;
+   tf->nextUpdate = 0;
+
+   /* Split the format into chunks for strftime and the conversions
+    * that depend on the zone, which are done here. */
+   expanded = ExpandTimeFormat(format);
+   format = expanded;
+   len = strlen(format);
+   chunk = AllocateStack(len + 1);
+   x = 0;
+   part = NULL;
+   while(*format) {
+      const char *start = format;
+      char custom = 0;
+      char c;
+      if(*format != '%') {
+         chunk[x++] = *format++;
+         continue;
+      }
+
+      /* Skip flags, width, and modifiers to get the conversion. */
+      format += 1;
+      while(*format && strchr("_-0^#", *format)) {
+         format += 1;
+      }
+      while(*format >= '0' && *format <= '9') {
+         format += 1;
+      }
+      if(*format == 'E' || *format == 'O') {
+         format += 1;
+      }
+      c = *format;
+      if(c == 0) {
+         break;
+      }
+      format += 1;
+      if(strchr("ScsTrX+", c)) {
+         tf->resolution = 1;
+      }
+      if(strchr("Zzs", c) && format - start == 2) {
+         custom = c;
+      }
+
+      if(custom) {
+         if(x > 0) {
+            part = AddTimeFormatPart(tf, part, 0, chunk, x);
+            x = 0;
+         }
+         part = AddTimeFormatPart(tf, part, custom, NULL, 0);
+      } else {
+         memcpy(&chunk[x], start, format - start);
+         x += format - start;
+      }
+   }
+   if(x > 0) {
+      AddTimeFormatPart(tf, part, 0, chunk, x);
+   }
+   ReleaseStack(chunk);
+   Release(expanded);
+
+   return tf;
+}
+
+/** Expand the locale's date and time formats in a format.
+ * This allows the zone conversions they contain to be done here.
+ * @return A new format string.
+ */
+char *ExpandTimeFormat(const char *format)
+{
+   char *result;
+   unsigned len, max;
+
+   max = strlen(format) + 1;
+   result = Allocate(max);
+   len = 0;
+   while(*format) {
+      const char *str = NULL;
+#ifdef HAVE_LANGINFO_H
+      if(format[0] == '%') {
+         switch(format[1]) {
+         case 'c':   str = nl_langinfo(D_T_FMT);      break;
+         case 'x':   str = nl_langinfo(D_FMT);        break;
+         case 'X':   str = nl_langinfo(T_FMT);        break;
+         case 'r':   str = nl_langinfo(T_FMT_AMPM);   break;
+         default:    break;
+         }
+      }
+#endif
+      if(str && str[0]) {
+         const unsigned count = strlen(str);
+         max += count;
+         result = Reallocate(result, max);
+         memcpy(&result[len], str, count);
+         len += count;
+         format += 2;
+      } else if(format[0] == '%' && format[1]) {
+         result[len++] = *format++;
+         result[len++] = *format++;
+      } else {
+         result[len++] = *format++;
+      }
+   }
+   result[len] = 0;
+   return result;
+}
+
+/** Append a part to a time format. */
+TimeFormatPart *AddTimeFormatPart(TimeFormatType *tf, TimeFormatPart *last,
+                                  char type, const char *text, unsigned len)
+{
+   TimeFormatPart *part = Allocate(sizeof(TimeFormatPart));
+   part->type = type;
+   part->text = NULL;
+   if(text) {
+      part->text = Allocate(len + 1);
+      memcpy(part->text, text, len);
+      part->text[len] = 0;
+   }
+   part->next = NULL;
+   if(last) {
+      last->next = part;
+   } else {
+      tf->parts = part;
+   }
+   return part;
+}
+
+/** Destroy a time format. */
+void DestroyTimeFormat(TimeFormatType *tf)
+{
+   while(tf->parts) {
+      TimeFormatPart *next = tf->parts->next;
+      if(tf->parts->text) {
+         Release(tf->parts->text);
+      }
+      Release(tf->parts);
+      tf->parts = next;
+   }
+   Release(tf);
+}
+
+/** Update the text of a time format. */
+char UpdateTimeFormat(TimeFormatType *tf, const TimeType *now)
+{
+   char text[TIME_STRING_SIZE];
+   const ZoneNode *zp = tf->zone;
+   const TimeFormatPart *part;
+   struct tm local;
+   time_t t;
+   long next;
+   unsigned len;
+
+   /* Nothing can change until the next update unless the clock was
+    * set back. */
+   if(tf->text[0] && (long)now->seconds < tf->nextUpdate
+      && (long)now->seconds >= tf->lastUpdate) {
+      return 0;
+   }
+
+   UpdateZone(tf->zone, (long)now->seconds);
+   t = (time_t)((long)now->seconds + zp->info.offset);
+   local = *gmtime(&t);
+   local.tm_isdst = zp->info.isdst;
+#ifdef HAVE_STRUCT_TM_TM_GMTOFF
+   local.tm_gmtoff = zp->info.offset;
+#endif
+#ifdef HAVE_STRUCT_TM_TM_ZONE
+   local.tm_zone = (char*)zp->info.abbr;
+#endif
+
+   len = 0;
+   for(part = tf->parts; part; part = part->next) {
+      const unsigned avail = sizeof(text) - len;
+      const long offset = zp->info.offset;
+      switch(part->type) {
+      case 'Z':
+         snprintf(&text[len], avail, "%s", zp->info.abbr);
+         break;
+      case 'z':
+         snprintf(&text[len], avail, "%c%02ld%02ld",
+                  offset < 0 ? '-' : '+',
+                  labs(offset) / 3600, (labs(offset) / 60) % 60);
+         break;
+      case 's':
+         snprintf(&text[len], avail, "%lu", now->seconds);
+         break;
+      default:
+         if(strftime(&text[len], avail, part->text, &local) == 0) {
+            text[len] = 0;
+         }
+         break;
+      }
+      len += strlen(&text[len]);
+   }
+   text[len] = 0;
+
+   /* Determine when the text can change next. */
+   if(tf->resolution == 1 || zp->info.offset % 60 != 0) {
+      next = (long)now->seconds + 1;
+   } else {
+      next = ((long)now->seconds / 60 + 1) * 60;
+   }
+   tf->lastUpdate = (long)now->seconds;
+   tf->nextUpdate = Min(next, zp->end);
+
+   if(!strcmp(text, tf->text)) {
+      return 0;
+   }
+   strcpy(tf->text, text);
+   return 1;
+}
+
+/** Get the text of a time format. */
+const char *GetTimeFormatString(const TimeFormatType *tf)
+{
+   return tf->text;
+}
+
+/** Get the cached data for a zone (NULL for local time). */
+ZoneNode *GetZone(const char *name)
+{
+   ZoneNode *zp;
+
+   for(zp = zones; zp; zp = zp->next) {
+      if(zp->name == NULL && name == NULL) {
+         return zp;
+      } else if(zp->name && name && !strcmp(zp->name, name)) {
+         return zp;
+      }
+   }
+
+   zp = Allocate(sizeof(ZoneNode));
+   memset(zp, 0, sizeof(ZoneNode));
+   zp->name = CopyString(name);
+   zp->start = 1;
+   zp->end = 0;
+   if(name) {
+      LoadZone(zp, name);
+   }
+   zp->next = zones;
+   zones = zp;
+   return zp;
+}
+
+/** Make sure the zone information is valid for a time. */
+void UpdateZone(ZoneNode *zp, long t)
+{
+   unsigned int low, high;
+
+   if(t >= zp->start && t < zp->end) {
+      return;
+   }
+
+   /* Look up the time in the transition table if possible. */
+   if(zp->types && (zp->timeCount == 0 || t < zp->times[zp->timeCount - 1]
+                    || !zp->footer)) {
+      if(zp->timeCount == 0 || t < zp->times[0]) {
+         zp->info = zp->types[0];
+         zp->start = LONG_MIN;
+         zp->end = zp->timeCount > 0 ? zp->times[0] : LONG_MAX;
+         return;
+      }
+      low = 0;
+      high = zp->timeCount;
+      while(high - low > 1) {
+         const unsigned int mid = (low + high) / 2;
+         if(zp->times[mid] <= t) {
+            low = mid;
+         } else {
+            high = mid;
+         }
+      }
+      zp->info = zp->types[zp->indexes[low]];
+      zp->start = zp->times[low];
+      zp->end = high < zp->timeCount ? zp->times[high] : LONG_MAX;
+      return;
+   }
+
+   /* Otherwise use the C library. Transitions happen on multiples of
+    * 15 minutes, so the result is valid until the next one. */
+   GetSystemZoneInfo(zp->footer ? zp->footer : zp->name, t, &zp->info);
+   zp->start = t - t % ZONE_PERIOD;
+   zp->end = zp->start + ZONE_PERIOD;
+}
+
+/** Get zone information from the C library.
+ * Note that this sets and restores the TZ environment variable.
+ * @param zone The zone in tzset() format (NULL for local time).
+ * @param t The time.
+ * @param info The zone information to fill.
+ */
+void GetSystemZoneInfo(const char *zone, long t, ZoneInfo *info)
 {
    static char saveTZ[256];
    static char newTZ[256];
-   static char str[80];
-   time_t t;
+   struct tm local, utc;
+   const time_t tt = (time_t)t;
+   long days;
 
-   time(&t);
    if(zone) {
       const char *oldTZ = getenv("TZ");
       if(oldTZ) {
@@ -74,7 +464,8 @@ const char *GetTimeString(const char *format, const char *zone)
       snprintf(newTZ, sizeof(newTZ), "TZ=%s", zone);
       putenv(newTZ);
       tzset();
-      strftime(str, sizeof(str), format, localtime(&t));
+      local = *localtime(&tt);
+      strftime(info->abbr, sizeof(info->abbr), "%Z", &local);
 #ifdef HAVE_UNSETENV
       if(oldTZ) {
          putenv(saveTZ);
@@ -84,9 +475,195 @@ const char *GetTimeString(const char *format, const char *zone)
 #else
       putenv(saveTZ);
 #endif
+      tzset();
    } else {
-      strftime(str, sizeof(str), format, localtime(&t));
+      local = *localtime(&tt);
+      strftime(info->abbr, sizeof(info->abbr), "%Z", &local);
    }
+   utc = *gmtime(&tt);
 
-   return str;
+   /* Compute the offset from UTC. */
+   days = local.tm_yday - utc.tm_yday;
+   if(local.tm_year != utc.tm_year) {
+      days = local.tm_year > utc.tm_year ? 1 : -1;
+   }
+   info->offset = ((days * 24 + local.tm_hour - utc.tm_hour) * 60
+                  + local.tm_min - utc.tm_min) * 60
+                  + local.tm_sec - utc.tm_sec;
+   info->isdst = local.tm_isdst > 0;
+}
+
+/** Read a big-endian 32-bit integer. */
+long ReadZoneInt32(const unsigned char *p)
+{
+   const unsigned long value = ((unsigned long)p[0] << 24)
+                             | ((unsigned long)p[1] << 16)
+                             | ((unsigned long)p[2] << 8)
+                             | (unsigned long)p[3];
+   if(value & 0x80000000UL) {
+      return -(long)(0xFFFFFFFFUL - value) - 1;
+   }
+   return (long)value;
+}
+
+/** Read a big-endian 64-bit integer (clamped to the range of long). */
+long ReadZoneInt64(const unsigned char *p)
+{
+   const long high = ReadZoneInt32(p);
+   const unsigned long low = (unsigned long)ReadZoneInt32(&p[4])
+                           & 0xFFFFFFFFUL;
+   if(sizeof(long) < 8) {
+      if(high == 0 && low <= (unsigned long)LONG_MAX) {
+         return (long)low;
+      } else if(high == -1 && low > (unsigned long)LONG_MAX) {
+         return -(long)(0xFFFFFFFFUL - low) - 1;
+      }
+      return high < 0 ? LONG_MIN : LONG_MAX;
+   }
+   return (long)((((unsigned long)high << 16) << 16) | low);
+}
+
+/** Load the transitions of a zone from its TZif file.
+ * Zones that cannot be loaded are handled by the C library.
+ */
+void LoadZone(ZoneNode *zp, const char *name)
+{
+   unsigned char *data;
+   const unsigned char *p;
+   const unsigned char *end;
+   const char *dir;
+   char *path;
+   FILE *fd;
+   long size;
+   unsigned long counts[6];
+   unsigned int timeSize;
+   unsigned int i;
+
+   /* Find the file. */
+   if(name[0] == ':') {
+      name += 1;
+   }
+   if(name[0] == '/') {
+      path = CopyString(name);
+   } else {
+      const unsigned len = strlen(name);
+      dir = getenv("TZDIR");
+      if(!dir || !dir[0]) {
+         dir = "/usr/share/zoneinfo";
+      }
+      path = Allocate(strlen(dir) + len + 2);
+      sprintf(path, "%s/%s", dir, name);
+   }
+   fd = fopen(path, "rb");
+   Release(path);
+   if(!fd) {
+      return;
+   }
+   fseek(fd, 0, SEEK_END);
+   size = ftell(fd);
+   fseek(fd, 0, SEEK_SET);
+   if(size < 44 || size > ZONE_MAX_SIZE) {
+      fclose(fd);
+      return;
+   }
+   data = Allocate(size);
+   if(fread(data, 1, size, fd) != (size_t)size || memcmp(data, "TZif", 4)) {
+      fclose(fd);
+      Release(data);
+      return;
+   }
+   fclose(fd);
+   end = data + size;
+
+   /* Use the 64-bit data for version 2 and later. */
+   p = data;
+   timeSize = 4;
+   for(;;) {
+      for(i = 0; i < 6; i++) {
+         counts[i] = (unsigned long)ReadZoneInt32(&p[20 + i * 4]);
+      }
+      if(timeSize == 8 || data[4] < '2') {
+         break;
+      }
+      /* Skip the version 1 data. */
+      p += 44 + counts[3] * 5 + counts[4] * 6 + counts[5]
+         + counts[2] * 8 + counts[1] + counts[0];
+      if(p + 44 > end || memcmp(p, "TZif", 4)) {
+         Release(data);
+         return;
+      }
+      timeSize = 8;
+   }
+   p += 44;
+
+   /* counts: isutcnt, isstdcnt, leapcnt, timecnt, typecnt, charcnt */
+   if(counts[4] == 0 || counts[4] > 256 || counts[3] > ZONE_MAX_SIZE
+      || p + counts[3] * (timeSize + 1) + counts[4] * 6 + counts[5]
+         + counts[2] * (timeSize + 4) + counts[1] + counts[0] > end) {
+      Release(data);
+      return;
+   }
+
+   zp->timeCount = counts[3];
+   zp->typeCount = counts[4];
+   zp->times = Allocate(Max(1, zp->timeCount) * sizeof(long));
+   zp->indexes = Allocate(Max(1, zp->timeCount));
+   zp->types = Allocate(zp->typeCount * sizeof(ZoneInfo));
+   for(i = 0; i < zp->timeCount; i++) {
+      zp->times[i] = timeSize == 8 ? ReadZoneInt64(p) : ReadZoneInt32(p);
+      p += timeSize;
+   }
+   for(i = 0; i < zp->timeCount; i++) {
+      zp->indexes[i] = *p < zp->typeCount ? *p : 0;
+      p += 1;
+   }
+   for(i = 0; i < zp->typeCount; i++) {
+      const unsigned int index = p[5];
+      zp->types[i].offset = ReadZoneInt32(p);
+      zp->types[i].isdst = p[4] != 0;
+      zp->types[i].abbr[0] = 0;
+      if(index < counts[5]) {
+         const char *abbr = (const char*)&p[6 * (zp->typeCount - i) + index];
+         const unsigned len = Min(counts[5] - index,
+                                  sizeof(zp->types[i].abbr) - 1);
+         memcpy(zp->types[i].abbr, abbr, len);
+         zp->types[i].abbr[len] = 0;
+      }
+      p += 6;
+   }
+   p += counts[5] + counts[2] * (timeSize + 4) + counts[1] + counts[0];
+
+   /* Version 2 files have a rule for times after the last transition. */
+   if(timeSize == 8 && p < end && *p == '\n') {
+      const unsigned char *start = p + 1;
+      for(p = start; p < end && *p != '\n'; p++);
+      if(p < end && p > start) {
+         zp->footer = Allocate(p - start + 1);
+         memcpy(zp->footer, start, p - start);
+         zp->footer[p - start] = 0;
+      }
+   }
+
+   Release(data);
+}
+
+/** Release cached zone data. */
+void DestroyTiming(void)
+{
+   while(zones) {
+      ZoneNode *next = zones->next;
+      if(zones->name) {
+         Release(zones->name);
+      }
+      if(zones->types) {
+         Release(zones->times);
+         Release(zones->indexes);
+         Release(zones->types);
+      }
+      if(zones->footer) {
+         Release(zones->footer);
+      }
+      Release(zones);
+      zones = next;
+   }
 }
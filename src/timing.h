@@ -10,6 +10,13 @@
 #ifndef TIMING_H
 #define TIMING_H
 
+/*@{*/
+#define InitializeTiming()    (void)(0)
+#define StartupTiming()       (void)(0)
+#define ShutdownTiming()      (void)(0)
+void DestroyTiming(void);
+/*@}*/
+
 /** Initializer for TimeType to indicate that it is not set. */
 #define ZERO_TIME { 0, 0 }
 
@@ -43,5 +50,35 @@ unsigned long GetTimeDifference(const TimeType *t1, const TimeType *t2);
  */
 const char *GetTimeString(const char *format, const char *zone);
 
+/** Precompiled time format for a zone. */
+typedef struct TimeFormatType TimeFormatType;
+
+/** Create a time format.
+ * The zone is loaded once and shared with other formats.
+ * @param format The strftime format.
+ * @param zone The timezone in tzset() format to use (NULL for local).
+ * @return The time format.
+ */
+TimeFormatType *CreateTimeFormat(const char *format, const char *zone);
+
+/** Destroy a time format.
+ * @param tf The time format to destroy.
+ */
+void DestroyTimeFormat(TimeFormatType *tf);
+
+/** Update the text of a time format.
+ * This does no work until the text could have changed.
+ * @param tf The time format.
+ * @param now The current time.
+ * @return 1 if the text changed, 0 otherwise.
+ */
+char UpdateTimeFormat(TimeFormatType *tf, const TimeType *now);
+
+/** Get the text of a time format.
+ * @param tf The time format.
+ * @return The text from the last update.
+ */
+const char *GetTimeFormatString(const TimeFormatType *tf);
+
 #endif /* TIMING_H */
 
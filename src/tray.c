@@ -23,17 +23,22 @@
 #include "client.h"
 #include "misc.h"
 #include "hint.h"
+#include "popup.h"
 
 #define DEFAULT_TRAY_WIDTH 32
 #define DEFAULT_TRAY_HEIGHT 32
 
 #define TRAY_BORDER_SIZE   1
 
+/** Milliseconds to wait after the mouse leaves a tray before hiding it. */
+#define TRAY_HIDE_DELAY    100
+
 static TrayType *trays;
 static unsigned int trayCount;
 
 static void HandleTrayExpose(TrayType *tp, const XExposeEvent *event);
 static void HandleTrayEnterNotify(TrayType *tp, const XCrossingEvent *event);
+static void HandleTrayLeaveNotify(TrayType *tp, const XCrossingEvent *event);
 
 static TrayComponentType *GetTrayComponent(TrayType *tp, int x, int y);
 static void HandleTrayButtonPress(TrayType *tp, const XButtonEvent *event);
@@ -50,8 +55,10 @@ static char CheckVerticalFill(TrayType *tp);
 static void LayoutTray(TrayType *tp, int *variableSize,
                        int *variableRemainder);
 
-static void SignalTray(const TimeType *now, int x, int y, Window w,
-                       void *data);
+static void CreateTrayBuffer(TrayType *tp);
+static void DamageTray(TrayType *tp, int x, int y, int width, int height);
+static void HideTrayTimeout(const TimeType *now, int x, int y, Window w,
+                            void *data);
 
 
 /** Initialize tray data. */
@@ -93,6 +100,7 @@ void StartupTray(void)
          | KeyPressMask
          | KeyReleaseMask
          | EnterWindowMask
+         | LeaveWindowMask
          | PointerMotionMask;
 
       attrMask |= CWBackPixel;
@@ -113,6 +121,7 @@ void StartupTray(void)
       }
 
       SetDefaultCursor(tp->window);
+      CreateTrayBuffer(tp);
 
       /* Create and layout items on the tray. */
       xoffset = TRAY_BORDER_SIZE;
@@ -150,6 +159,10 @@ void StartupTray(void)
          cp->y = yoffset;
          cp->screenx = tp->x + xoffset;
          cp->screeny = tp->y + yoffset;
+         cp->layoutWidth = cp->width;
+         cp->layoutHeight = cp->height;
+         cp->layoutRequestedWidth = cp->requestedWidth;
+         cp->layoutRequestedHeight = cp->requestedHeight;
 
          if(cp->window != None) {
             JXReparentWindow(display, cp->window, tp->window,
@@ -165,6 +178,9 @@ void StartupTray(void)
 
       /* Show the tray. */
       JXMapWindow(display, tp->window);
+      if(tp->autoHide != THIDE_OFF) {
+         RegisterTimeout(TRAY_HIDE_DELAY, HideTrayTimeout, tp);
+      }
 
       trayCount += 1;
 
@@ -186,7 +202,10 @@ void ShutdownTray(void)
             (cp->Destroy)(cp);
          }
       }
+      CancelTimeout(HideTrayTimeout, tp);
       JXDestroyWindow(display, tp->window);
+      JXFreePixmap(display, tp->buffer);
+      tp->buffer = None;
    }
 }
 
@@ -198,7 +217,6 @@ void DestroyTray(void)
 
    while(trays) {
       tp = trays->next;
-      UnregisterCallback(SignalTray, trays);
       while(trays->components) {
          cp = trays->components->next;
          Release(trays->components);
@@ -232,8 +250,11 @@ TrayType *CreateTray(void)
 
    tp->autoHide = THIDE_OFF;
    tp->hidden = 0;
+   tp->grabbed = 0;
 
    tp->window = None;
+   tp->buffer = None;
+   tp->damageRight = 0;
 
    tp->components = NULL;
    tp->componentsTail = NULL;
@@ -241,8 +262,6 @@ TrayType *CreateTray(void)
    tp->next = trays;
    trays = tp;
 
-   RegisterCallback(100, SignalTray, tp);
-
    return tp;
 }
 
@@ -262,6 +281,10 @@ TrayComponentType *CreateTrayComponent(void)
    cp->requestedHeight = 0;
    cp->width = 0;
    cp->height = 0;
+   cp->layoutWidth = 0;
+   cp->layoutHeight = 0;
+   cp->layoutRequestedWidth = 0;
+   cp->layoutRequestedHeight = 0;
    cp->grabbed = 0;
 
    cp->window = None;
@@ -272,6 +295,7 @@ TrayComponentType *CreateTrayComponent(void)
 
    cp->SetSize = NULL;
    cp->Resize = NULL;
+   cp->Move = NULL;
 
    cp->ProcessButtonPress = NULL;
    cp->ProcessButtonRelease = NULL;
@@ -625,6 +649,9 @@ char ProcessTrayEvent(const XEvent *event)
          case EnterNotify:
             HandleTrayEnterNotify(tp, &event->xcrossing);
             return 1;
+         case LeaveNotify:
+            HandleTrayLeaveNotify(tp, &event->xcrossing);
+            return 1;
          case ButtonPress:
             HandleTrayButtonPress(tp, &event->xbutton);
             return 1;
@@ -643,30 +670,59 @@ char ProcessTrayEvent(const XEvent *event)
    return 0;
 }
 
-/** Signal the tray (needed for autohide). */
-void SignalTray(const TimeType *now, int x, int y, Window w, void *data)
+/** Hide a tray after the mouse leaves it. */
+void HideTrayTimeout(const TimeType *now, int x, int y, Window w, void *data)
 {
    TrayType *tp = (TrayType*)data;
-   if(tp->autoHide != THIDE_OFF && !tp->hidden && !menuShown) {
-      if(x < tp->x || x >= tp->x + tp->width
-         || y < tp->y || y >= tp->y + tp->height) {
-         HideTray(tp);
-      }
+   if(tp->hidden) {
+      return;
+   }
+   if(menuShown) {
+      /* Check again once the menu is closed. */
+      RegisterTimeout(TRAY_HIDE_DELAY, HideTrayTimeout, tp);
+   } else if(x < tp->x || x >= tp->x + tp->width
+             || y < tp->y || y >= tp->y + tp->height) {
+      tp->grabbed = 0;
+      HideTray(tp);
+   } else if(tp->grabbed) {
+      /* No leave event is sent if the grab ends outside of the tray. */
+      RegisterTimeout(TRAY_HIDE_DELAY, HideTrayTimeout, tp);
    }
 }
 
 /** Handle a tray expose event. */
 void HandleTrayExpose(TrayType *tp, const XExposeEvent *event)
 {
-   DrawSpecificTray(tp);
+   DamageTray(tp, event->x, event->y, event->width, event->height);
 }
 
 /** Handle a tray enter notify (for autohide). */
 void HandleTrayEnterNotify(TrayType *tp, const XCrossingEvent *event)
 {
+   if(tp->autoHide != THIDE_OFF) {
+      CancelTimeout(HideTrayTimeout, tp);
+   }
+   tp->grabbed = 0;
    ShowTray(tp);
 }
 
+/** Handle a tray leave notify (for popups and autohide). */
+void HandleTrayLeaveNotify(TrayType *tp, const XCrossingEvent *event)
+{
+   CancelPopupHover();
+
+   /* Moving into a swallowed window does not leave the tray.
+    * A grab (for a menu or a drag) may end anywhere, so the timeout
+    * keeps checking until the mouse is outside of the tray. */
+   if(   tp->autoHide != THIDE_OFF && !tp->hidden
+      && event->detail != NotifyInferior) {
+      if(event->mode == NotifyGrab) {
+         tp->grabbed = 1;
+      }
+      RegisterTimeout(TRAY_HIDE_DELAY, HideTrayTimeout, tp);
+   }
+}
+
 /** Get the tray component under the given coordinates. */
 TrayComponentType *GetTrayComponent(TrayType *tp, int x, int y)
 {
@@ -761,8 +817,28 @@ void DrawTray(void)
    }
 }
 
+/** Redraw the components of all trays that draw their own contents. */
+void RedrawTrays(void)
+{
+   TrayType *tp;
+   TrayComponentType *cp;
+
+   if(shouldExit) {
+      return;
+   }
+
+   for(tp = trays; tp; tp = tp->next) {
+      for(cp = tp->components; cp; cp = cp->next) {
+         if(cp->Redraw) {
+            (cp->Redraw)(cp);
+            UpdateSpecificTray(tp, cp);
+         }
+      }
+   }
+}
+
 /** Draw a specific tray. */
-void DrawSpecificTray(const TrayType *tp)
+void DrawSpecificTray(TrayType *tp)
 {
    TrayComponentType *cp;
 
@@ -772,19 +848,20 @@ void DrawSpecificTray(const TrayType *tp)
 
    if(settings.trayDecorations == DECO_MOTIF) {
       JXSetForeground(display, rootGC, colors[COLOR_TRAY_UP]);
-      JXDrawLine(display, tp->window, rootGC, 0, 0, tp->width - 1, 0);
-      JXDrawLine(display, tp->window, rootGC, 0, tp->height - 1, 0, 0);
+      JXDrawLine(display, tp->buffer, rootGC, 0, 0, tp->width - 1, 0);
+      JXDrawLine(display, tp->buffer, rootGC, 0, tp->height - 1, 0, 0);
 
       JXSetForeground(display, rootGC, colors[COLOR_TRAY_DOWN]);
-      JXDrawLine(display, tp->window, rootGC, 0, tp->height - 1,
+      JXDrawLine(display, tp->buffer, rootGC, 0, tp->height - 1,
                  tp->width - 1, tp->height - 1);
-      JXDrawLine(display, tp->window, rootGC, tp->width - 1, 0,
+      JXDrawLine(display, tp->buffer, rootGC, tp->width - 1, 0,
                  tp->width - 1, tp->height - 1);
    } else {
       JXSetForeground(display, rootGC, colors[COLOR_TRAY_DOWN]);
-      JXDrawRectangle(display, tp->window, rootGC, 0, 0,
+      JXDrawRectangle(display, tp->buffer, rootGC, 0, 0,
                       tp->width - 1, tp->height - 1);
    }
+   DamageTray(tp, 0, 0, tp->width, tp->height);
 }
 
 /** Raise tray windows. */
@@ -804,22 +881,88 @@ void LowerTrays(void)
    TrayType *tp;
    for(tp = trays; tp; tp = tp->next) {
       tp->autoHide &= ~THIDE_RAISED;
+      if(tp->autoHide != THIDE_OFF && !tp->hidden) {
+         RegisterTimeout(TRAY_HIDE_DELAY, HideTrayTimeout, tp);
+      }
    }
    RequireRestack();
 }
 
 /** Update a specific component on a tray. */
-void UpdateSpecificTray(const TrayType *tp, const TrayComponentType *cp)
+void UpdateSpecificTray(TrayType *tp, const TrayComponentType *cp)
+{
+   UpdateSpecificTrayArea(tp, cp, 0, 0, cp->width, cp->height);
+}
+
+/** Update part of a component on a tray. */
+void UpdateSpecificTrayArea(TrayType *tp, const TrayComponentType *cp,
+                            int x, int y, int width, int height)
 {
    if(JUNLIKELY(shouldExit)) {
       return;
    }
+   if(cp->pixmap != None && tp->buffer != None) {
+      JXCopyArea(display, cp->pixmap, tp->buffer, rootGC, x, y,
+                 width, height, cp->x + x, cp->y + y);
+      DamageTray(tp, cp->x + x, cp->y + y, width, height);
+   }
+}
+
+/** Mark part of a tray to be copied to the tray window. */
+void DamageTray(TrayType *tp, int x, int y, int width, int height)
+{
+   if(tp->damageRight == 0) {
+      tp->damageLeft = x;
+      tp->damageTop = y;
+      tp->damageRight = x + width;
+      tp->damageBottom = y + height;
+   } else {
+      tp->damageLeft = Min(tp->damageLeft, x);
+      tp->damageTop = Min(tp->damageTop, y);
+      tp->damageRight = Max(tp->damageRight, x + width);
+      tp->damageBottom = Max(tp->damageBottom, y + height);
+   }
+}
+
+/** Copy the damaged parts of the tray back-buffers to the tray windows. */
+void FlushTrays(void)
+{
+   TrayType *tp;
+   for(tp = trays; tp; tp = tp->next) {
+      if(tp->damageRight > 0 && tp->buffer != None) {
+         const int x = Max(0, tp->damageLeft);
+         const int y = Max(0, tp->damageTop);
+         const int width = Min(tp->width, tp->damageRight) - x;
+         const int height = Min(tp->height, tp->damageBottom) - y;
+         if(width > 0 && height > 0) {
+            JXCopyArea(display, tp->buffer, tp->window, rootGC,
+                       x, y, width, height, x, y);
+         }
+      }
+      tp->damageRight = 0;
+   }
+}
 
-   /* If the tray is hidden, draw only the background. */
-   if(cp->pixmap != None) {
-      JXCopyArea(display, cp->pixmap, tp->window, rootGC, 0, 0,
-                 cp->width, cp->height, cp->x, cp->y);
+/** Create the back-buffer for a tray.
+ * The buffer only batches window updates into one copy per pass
+ * through the event loop; it does not replace component pixmaps and
+ * adds one tray-sized pixmap per tray.
+ * Components keep their own pixmaps, which are copied into the buffer.
+ * The pixmaps are what allow a component to be moved on the tray
+ * without being redrawn and to update only the part that changed (for
+ * example, clock digits). If components drew into the buffer directly,
+ * every layout change would have to redraw every component that moved.
+ */
+void CreateTrayBuffer(TrayType *tp)
+{
+   if(tp->buffer != None) {
+      JXFreePixmap(display, tp->buffer);
    }
+   tp->buffer = JXCreatePixmap(display, rootWindow, tp->width, tp->height,
+                               rootDepth);
+   JXSetForeground(display, rootGC, colors[COLOR_TRAY_BG2]);
+   JXFillRectangle(display, tp->buffer, rootGC, 0, 0,
+                   tp->width, tp->height);
 }
 
 /** Layout tray components on a tray. */
@@ -917,20 +1060,39 @@ void ResizeTray(TrayType *tp)
    int variableRemainder;
    int xoffset, yoffset;
    int width, height;
+   int oldx, oldy, oldWidth, oldHeight;
+   char moved;
 
    Assert(tp);
 
+   oldx = tp->x;
+   oldy = tp->y;
+   oldWidth = tp->width;
+   oldHeight = tp->height;
    LayoutTray(tp, &variableSize, &variableRemainder);
+   if(tp->width != oldWidth || tp->height != oldHeight) {
+      CreateTrayBuffer(tp);
+   }
 
-   /* Reposition items on the tray. */
+   /* Resize components whose size changed and move components that
+    * were shifted by a change before them or by moving the tray. */
    xoffset = TRAY_BORDER_SIZE;
    yoffset = TRAY_BORDER_SIZE;
    for(cp = tp->components; cp; cp = cp->next) {
 
-      cp->x = xoffset;
-      cp->y = yoffset;
-      cp->screenx = tp->x + xoffset;
-      cp->screeny = tp->y + yoffset;
+      if(cp->x != xoffset || cp->y != yoffset) {
+         cp->x = xoffset;
+         cp->y = yoffset;
+         if(cp->window != None) {
+            JXMoveWindow(display, cp->window, xoffset, yoffset);
+         }
+      }
+      moved = 0;
+      if(cp->screenx != tp->x + xoffset || cp->screeny != tp->y + yoffset) {
+         cp->screenx = tp->x + xoffset;
+         cp->screeny = tp->y + yoffset;
+         moved = 1;
+      }
 
       if(cp->Resize) {
          if(tp->layout == LAYOUT_HORIZONTAL) {
@@ -956,12 +1118,20 @@ void ResizeTray(TrayType *tp)
          }
          cp->width = width;
          cp->height = height;
-         (cp->Resize)(cp);
+         if(   width != cp->layoutWidth || height != cp->layoutHeight
+            || cp->requestedWidth != cp->layoutRequestedWidth
+            || cp->requestedHeight != cp->layoutRequestedHeight) {
+            (cp->Resize)(cp);
+            moved = 0;
+         }
       }
-
-      if(cp->window != None) {
-         JXMoveWindow(display, cp->window, xoffset, yoffset);
+      if(moved && cp->Move) {
+         (cp->Move)(cp);
       }
+      cp->layoutWidth = cp->width;
+      cp->layoutHeight = cp->height;
+      cp->layoutRequestedWidth = cp->requestedWidth;
+      cp->layoutRequestedHeight = cp->requestedHeight;
 
       if(tp->layout == LAYOUT_HORIZONTAL) {
          xoffset += cp->width;
@@ -970,8 +1140,11 @@ void ResizeTray(TrayType *tp)
       }
    }
 
-   JXMoveResizeWindow(display, tp->window, tp->x, tp->y,
-                      tp->width, tp->height);
+   if(   tp->x != oldx || tp->y != oldy
+      || tp->width != oldWidth || tp->height != oldHeight) {
+      JXMoveResizeWindow(display, tp->window, tp->x, tp->y,
+                         tp->width, tp->height);
+   }
 
    RequireTaskUpdate();
    DrawSpecificTray(tp);
@@ -76,6 +76,13 @@ typedef struct TrayComponentType {
    int width;     /**< Actual width. */
    int height;    /**< Actual height. */
 
+   /* The following are used to skip components that did not change
+    * when the tray is resized. */
+   int layoutWidth;           /**< Width at the last layout. */
+   int layoutHeight;          /**< Height at the last layout. */
+   int layoutRequestedWidth;  /**< Requested width at the last layout. */
+   int layoutRequestedHeight; /**< Requested height at the last layout. */
+
    char grabbed;     /**< 1 if the mouse was grabbed by this component. */
 
    Window window;    /**< Content (if a window, otherwise None). */
@@ -97,6 +104,11 @@ typedef struct TrayComponentType {
    /** Callback to resize the component. */
    void (*Resize)(struct TrayComponentType *cp);
 
+   /** Callback for a component that moved on the screen without
+    * changing size.
+    */
+   void (*Move)(struct TrayComponentType *cp);
+
    /** Callback for mouse presses. */
    void (*ProcessButtonPress)(struct TrayComponentType *cp,
                               int x, int y, int mask);
@@ -141,8 +153,15 @@ typedef struct TrayType {
 
    TrayAutoHideType  autoHide;
    char hidden;     /**< 1 if hidden (due to autohide), 0 otherwise. */
+   char grabbed;    /**< 1 if the mouse left the tray for a grab. */
 
    Window window; /**< The tray window. */
+   Pixmap buffer; /**< Staging copy of the tray for batched flushes. */
+
+   int damageLeft;   /**< Left edge of the area to flush. */
+   int damageTop;    /**< Top edge of the area to flush. */
+   int damageRight;  /**< Right edge of the area to flush (exclusive). */
+   int damageBottom; /**< Bottom edge of the area to flush (exclusive). */
 
    /** Start of the tray components. */
    struct TrayComponentType *components;
@@ -191,10 +210,13 @@ void HideTray(TrayType *tp);
 /** Draw all trays. */
 void DrawTray(void);
 
+/** Redraw the components of all trays that draw their own contents. */
+void RedrawTrays(void);
+
 /** Draw a specific tray.
  * @param tp The tray to draw.
  */
-void DrawSpecificTray(const TrayType *tp);
+void DrawSpecificTray(TrayType *tp);
 
 /** Raise tray windows. */
 void RaiseTrays(void);
@@ -203,12 +225,31 @@ void RaiseTrays(void);
 void LowerTrays(void);
 
 /** Update a component on a tray.
+ * The component is copied to the back-buffer of the tray. The tray
+ * window is updated by the next call to FlushTrays.
  * @param tp The tray containing the component.
  * @param cp The component that needs updating.
  */
-void UpdateSpecificTray(const TrayType *tp, const TrayComponentType *cp);
+void UpdateSpecificTray(TrayType *tp, const TrayComponentType *cp);
+
+/** Update part of a component on a tray.
+ * @param tp The tray containing the component.
+ * @param cp The component that needs updating.
+ * @param x The x-coordinate of the area relative to the component.
+ * @param y The y-coordinate of the area relative to the component.
+ * @param width The width of the area.
+ * @param height The height of the area.
+ */
+void UpdateSpecificTrayArea(TrayType *tp, const TrayComponentType *cp,
+                            int x, int y, int width, int height);
+
+/** Copy the changed parts of the tray back-buffers to the tray windows.
+ * This is called once per pass through the event loop.
+ */
+void FlushTrays(void);
 
 /** Resize a tray.
+ * Only components whose size or requested size changed are resized.
  * @param tp The tray to resize containing the new requested size information.
  */
 void ResizeTray(TrayType *tp);
@@ -37,10 +37,6 @@ typedef struct TrayButtonType {
    char *iconName;
    IconNode *icon;
 
-   int mousex;
-   int mousey;
-   TimeType mouseTime;
-
    struct ActionType *actions;
    struct TrayButtonType *next;
 
@@ -60,8 +56,7 @@ static void ProcessButtonRelease(TrayComponentType *cp,
                                  int x, int y, int button);
 static void ProcessMotionEvent(TrayComponentType *cp,
                                int x, int y, int mask);
-static void SignalTrayButton(const TimeType *now,
-                             int x, int y, Window w, void *data);
+static void ShowTrayButtonPopup(void *data, int x, int y);
 
 /** Startup tray buttons. */
 void StartupTrayButtons(void)
@@ -98,7 +93,6 @@ void DestroyTrayButtons(void)
    TrayButtonType *bp;
    while(buttons) {
       bp = buttons->next;
-      UnregisterCallback(SignalTrayButton, buttons);
       if(buttons->label) {
          Release(buttons->label);
       }
@@ -137,6 +131,7 @@ TrayComponentType *CreateTrayButton(const char *iconName,
 
    bp->icon = NULL;
    bp->iconName = CopyString(iconName);
+   PreloadIcon(iconName);
    bp->label = CopyString(label);
    bp->actions = NULL;
    bp->popup = CopyString(popup);
@@ -147,9 +142,6 @@ TrayComponentType *CreateTrayButton(const char *iconName,
    cp->requestedWidth = width;
    cp->requestedHeight = height;
 
-   bp->mousex = -settings.doubleClickDelta;
-   bp->mousey = -settings.doubleClickDelta;
-
    cp->Create = Create;
    cp->Destroy = Destroy;
    cp->SetSize = SetSize;
@@ -162,8 +154,6 @@ TrayComponentType *CreateTrayButton(const char *iconName,
       cp->ProcessMotionEvent = ProcessMotionEvent;
    }
 
-   RegisterCallback(settings.popupDelay / 2, SignalTrayButton, bp);
-
    return cp;
 
 }
@@ -312,31 +302,18 @@ void ProcessButtonRelease(TrayComponentType *cp, int x, int y, int button)
 /** Process a motion event. */
 void ProcessMotionEvent(TrayComponentType *cp, int x, int y, int mask)
 {
-   TrayButtonType *bp = (TrayButtonType*)cp->object;
-   bp->mousex = cp->screenx + x;
-   bp->mousey = cp->screeny + y;
-   GetCurrentTime(&bp->mouseTime);
+   UpdatePopupHover(ShowTrayButtonPopup, cp->object, cp->tray->window,
+                    cp->screenx + x, cp->screeny + y);
 }
 
-/** Signal (needed for popups). */
-void SignalTrayButton(const TimeType *now, int x, int y, Window w, void *data)
+/** Show the popup for a tray button. */
+void ShowTrayButtonPopup(void *data, int x, int y)
 {
-   TrayButtonType *bp = (TrayButtonType*)data;
-   const char *popup;
-
+   const TrayButtonType *bp = (TrayButtonType*)data;
    if(bp->popup) {
-      popup = bp->popup;
+      ShowPopup(x, y, bp->popup, POPUP_BUTTON);
    } else if(bp->label) {
-      popup = bp->label;
-   } else {
-      return;
-   }
-   if(bp->cp->tray->window == w &&
-      abs(bp->mousex - x) < settings.doubleClickDelta &&
-      abs(bp->mousey - y) < settings.doubleClickDelta) {
-      if(GetTimeDifference(now, &bp->mouseTime) >= settings.popupDelay) {
-         ShowPopup(x, y, popup, POPUP_BUTTON);
-      }
+      ShowPopup(x, y, bp->label, POPUP_BUTTON);
    }
 }
 
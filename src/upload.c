@@ -0,0 +1,202 @@
+/**
+ * @file upload.c
+ *
+ * @brief Functions to upload images to the X server.
+ *
+ * When the MIT-SHM extension is available, large images are placed in a
+ * shared memory segment that is reused between uploads. Otherwise, or if
+ * the segment cannot be attached (for example, on a remote display),
+ * images are sent over the connection with XPutImage.
+ *
+ */
+
+#include "jwm.h"
+#include "upload.h"
+#include "main.h"
+
+#ifdef USE_SHM
+
+/** Images smaller than this (in bytes) are sent over the connection. */
+#define MIN_SHM_SIZE (32 * 1024)
+
+static XShmSegmentInfo shmInfo;
+static char haveShm = 0;
+static char shmAttached = 0;
+static char shmError = 0;
+static size_t shmSize = 0;
+static size_t shmUsed = 0;
+static unsigned shmImages = 0;
+
+static char IsShmImage(const XImage *image);
+static char ResizeSegment(size_t size);
+static void DetachSegment(void);
+static int HandleShmError(Display *d, XErrorEvent *e);
+
+#endif /* USE_SHM */
+
+/** Startup image uploads. */
+void StartupUpload(void)
+{
+#ifdef USE_SHM
+   haveShm = JXShmQueryExtension(display);
+   if(haveShm) {
+      Debug("MIT-SHM extension enabled");
+   } else {
+      Debug("MIT-SHM extension disabled");
+   }
+#endif
+}
+
+/** Shutdown image uploads. */
+void ShutdownUpload(void)
+{
+#ifdef USE_SHM
+   DetachSegment();
+#endif
+}
+
+/** Create an image for uploading to the X server. */
+XImage *CreateUploadImage(int depth, int width, int height)
+{
+   XImage *image;
+
+#ifdef USE_SHM
+   if(haveShm) {
+      image = JXShmCreateImage(display, rootVisual, depth, ZPixmap,
+                               NULL, &shmInfo, width, height);
+      if(JLIKELY(image)) {
+         const size_t size = (image->bytes_per_line * image->height + 63)
+                           & ~(size_t)63;
+         if(size >= MIN_SHM_SIZE) {
+            if(shmImages == 0 && size > shmSize) {
+               /* Leave room for a mask with the image. */
+               ResizeSegment(size + size / 2);
+            }
+            if(shmAttached && shmUsed + size <= shmSize) {
+               image->data = shmInfo.shmaddr + shmUsed;
+               shmUsed += size;
+               shmImages += 1;
+               return image;
+            }
+         }
+         JXDestroyImage(image);
+      }
+   }
+#endif
+
+   image = JXCreateImage(display, rootVisual, depth, ZPixmap, 0, NULL,
+                         width, height, 8, 0);
+   image->data = Allocate(image->bytes_per_line * height);
+   return image;
+}
+
+/** Upload an image. */
+void PutUploadImage(Drawable d, GC gc, XImage *image)
+{
+#ifdef USE_SHM
+   if(IsShmImage(image)) {
+      JXShmPutImage(display, d, gc, image, 0, 0, 0, 0,
+                    image->width, image->height, False);
+      return;
+   }
+#endif
+   JXPutImage(display, d, gc, image, 0, 0, 0, 0,
+              image->width, image->height);
+}
+
+/** Destroy an image created with CreateUploadImage. */
+void DestroyUploadImage(XImage *image)
+{
+#ifdef USE_SHM
+   if(IsShmImage(image)) {
+      image->data = NULL;
+      JXDestroyImage(image);
+      shmImages -= 1;
+      if(shmImages == 0) {
+         /* Wait for the server to finish reading the segment. */
+         JXSync(display, False);
+         shmUsed = 0;
+      }
+      return;
+   }
+#endif
+   Release(image->data);
+   image->data = NULL;
+   JXDestroyImage(image);
+}
+
+#ifdef USE_SHM
+
+/** Determine if an image uses the shared memory segment. */
+char IsShmImage(const XImage *image)
+{
+   return shmAttached
+      && image->data >= shmInfo.shmaddr
+      && image->data < shmInfo.shmaddr + shmSize;
+}
+
+/** Replace the shared memory segment with one of the specified size.
+ * Shared memory is disabled if the segment cannot be attached.
+ */
+char ResizeSegment(size_t size)
+{
+   int (*oldHandler)(Display*, XErrorEvent*);
+
+   DetachSegment();
+
+   shmInfo.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+   if(JUNLIKELY(shmInfo.shmid < 0)) {
+      haveShm = 0;
+      return 0;
+   }
+   shmInfo.shmaddr = shmat(shmInfo.shmid, NULL, 0);
+   if(JUNLIKELY(shmInfo.shmaddr == (char*)-1)) {
+      shmctl(shmInfo.shmid, IPC_RMID, NULL);
+      haveShm = 0;
+      return 0;
+   }
+   shmInfo.readOnly = True;
+
+   /* The attach fails for remote displays. */
+   shmError = 0;
+   JXSync(display, False);
+   oldHandler = JXSetErrorHandler(HandleShmError);
+   JXShmAttach(display, &shmInfo);
+   JXSync(display, False);
+   JXSetErrorHandler(oldHandler);
+
+   /* The segment is removed once both sides have detached. */
+   shmctl(shmInfo.shmid, IPC_RMID, NULL);
+   if(JUNLIKELY(shmError)) {
+      Debug("MIT-SHM attach failed; using XPutImage");
+      shmdt(shmInfo.shmaddr);
+      haveShm = 0;
+      return 0;
+   }
+
+   shmAttached = 1;
+   shmSize = size;
+   return 1;
+}
+
+/** Release the shared memory segment. */
+void DetachSegment(void)
+{
+   if(shmAttached) {
+      JXShmDetach(display, &shmInfo);
+      JXSync(display, False);
+      shmdt(shmInfo.shmaddr);
+      shmAttached = 0;
+   }
+   shmSize = 0;
+   shmUsed = 0;
+}
+
+/** Error handler used while attaching the shared memory segment. */
+int HandleShmError(Display *d, XErrorEvent *e)
+{
+   shmError = 1;
+   return 0;
+}
+
+#endif /* USE_SHM */
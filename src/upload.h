@@ -0,0 +1,39 @@
+/**
+ * @file upload.h
+ *
+ * @brief Functions to upload images to the X server.
+ *
+ */
+
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+/*@{*/
+#define InitializeUpload()   (void)(0)
+void StartupUpload(void);
+void ShutdownUpload(void);
+#define DestroyUpload()      (void)(0)
+/*@}*/
+
+/** Create an image for uploading to the X server.
+ * Large images are placed in shared memory if possible.
+ * @param depth The depth of the image.
+ * @param width The width of the image.
+ * @param height The height of the image.
+ * @return The image.
+ */
+XImage *CreateUploadImage(int depth, int width, int height);
+
+/** Upload an image.
+ * @param d The destination drawable.
+ * @param gc The graphics context to use.
+ * @param image The image created with CreateUploadImage.
+ */
+void PutUploadImage(Drawable d, GC gc, XImage *image);
+
+/** Destroy an image created with CreateUploadImage.
+ * @param image The image to destroy.
+ */
+void DestroyUploadImage(XImage *image);
+
+#endif /* UPLOAD_H */